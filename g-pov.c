@@ -27,12 +27,32 @@
  *
  */
 
+/* RTLD_NEXT, for the allocation profile */
+#if defined(POV_ALLOC_PROFILE) && !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE
+#endif
+
 #include "common.h"
 
 /* system headers */
 #include <stdlib.h>
+#include <stdarg.h>
 #include <math.h>
 #include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#ifdef __linux__
+#  include <linux/perf_event.h>
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+#if defined(POV_ALLOC_PROFILE) && defined(HAVE_DLFCN_H)
+#  include <dlfcn.h>
+#  ifdef RTLD_NEXT
+#    define POV_ALLOC_HOOKS 1
+#  endif
+#endif
 #include "bio.h"
 
 /* interface headers */
@@ -47,183 +67,5254 @@
 struct user_data {
     long int data;
     struct bn_tol tol;
+    struct rt_tess_tol ttol;
+    int ncpu;		/* workers for parallel emitters (-P) */
+    size_t pnts_group;	/* points per bounded group (-G), 0 for one */
+};
+
+static void pov_cline_flush(void);
+static void pov_material(const struct mater_info *mp);
+union tree *primitive_func(struct db_tree_state *tsp, const struct db_full_path *pathp, struct rt_db_internal *ip, void *client_data);
+
+
+/* leveled logging: messages up to pov_log_level are kept in a buffer
+ * per thread and written out together by pov_log_flush(), so neither
+ * the walk nor the emitters' workers stop for stderr.  Errors go out
+ * at once.  Below the level nothing is formatted at all.
+ */
+#define POV_LOG_ERROR 0
+#define POV_LOG_WARN 1
+#define POV_LOG_INFO 2	/* -v, each region and primitive */
+#define POV_LOG_DEBUG 3	/* -v -v, tolerances too */
+static int pov_log_level = POV_LOG_WARN;
+#define POV_LOGGING(level) ((level) <= pov_log_level)
+
+#define POV_LOG_BUFSIZE 65536
+struct pov_log_buf {
+    size_t used;
+    char buf[POV_LOG_BUFSIZE];
 };
+static struct pov_log_buf *log_bufs[MAX_PSW];
+
+
+static void
+pov_log_write(struct pov_log_buf *lp)
+{
+    if (!lp->used)
+	return;
+    lp->buf[lp->used] = '\0';
+    bu_log("%s", lp->buf);
+    lp->used = 0;
+}
+
 
 /**
- * @brief describe_tree
+ * @brief Write out every thread's buffered messages.  Only called by
+ * the walking thread, outside of the emitters' parallel sections.
+ */
+static void
+pov_log_flush(void)
+{
+    int i;
+
+    for (i = 0; i < MAX_PSW; i++)
+	if (log_bufs[i])
+	    pov_log_write(log_bufs[i]);
+}
+
+
+#ifndef POV_EMITTERS_ONLY
+/**
+ * @brief bu_bomb() hook, and at exit: write out what is still
+ * buffered, so that a run cut short by an error keeps its warnings.
+ */
+static int
+pov_log_bomb(void *UNUSED(clientdata), void *UNUSED(str))
+{
+    pov_log_flush();
+    return 0;
+}
+
+
+static void
+pov_log_exit(void)
+{
+    pov_log_flush();
+}
+#endif /* POV_EMITTERS_ONLY */
+
+
+static void
+pov_log_free(void)
+{
+    int i;
+
+    pov_log_flush();
+    for (i = 0; i < MAX_PSW; i++) {
+	if (log_bufs[i])
+	    bu_free(log_bufs[i], "pov_log_buf");
+	log_bufs[i] = NULL;
+    }
+}
+
+
+static void
+pov_log_direct(const char *fmt, va_list ap)
+{
+    struct bu_vls str = BU_VLS_INIT_ZERO;
+
+    bu_vls_vprintf(&str, fmt, ap);
+    bu_log("%s", bu_vls_addr(&str));
+    bu_vls_free(&str);
+}
+
+
+/**
+ * @brief bu_log() at a level.  The message is formatted straight into
+ * the calling thread's buffer, which is written out first when it is
+ * full.  Callers that build arguments just to log them should check
+ * POV_LOGGING() first.
+ */
+static void
+pov_log(int level, const char *fmt, ...)
+{
+    struct pov_log_buf *lp;
+    va_list ap;
+    int cpu, len;
+
+    if (!POV_LOGGING(level))
+	return;
+
+    if (level == POV_LOG_ERROR) {
+	if (!bu_is_parallel())
+	    pov_log_flush();
+	va_start(ap, fmt);
+	pov_log_direct(fmt, ap);
+	va_end(ap);
+	return;
+    }
+
+    cpu = bu_parallel_id();
+    if (cpu < 0 || cpu >= MAX_PSW)
+	cpu = 0;
+    if (!log_bufs[cpu])
+	log_bufs[cpu] = (struct pov_log_buf *)bu_calloc(1, sizeof(struct pov_log_buf), "pov_log_buf");
+    lp = log_bufs[cpu];
+
+    va_start(ap, fmt);
+    len = vsnprintf(lp->buf + lp->used, POV_LOG_BUFSIZE - lp->used, fmt, ap);
+    va_end(ap);
+    if (len < 0)
+	return;
+    if (lp->used + len < POV_LOG_BUFSIZE) {
+	lp->used += len;
+	return;
+    }
+
+    /* it did not fit: write out what was there and try again */
+    pov_log_write(lp);
+    va_start(ap, fmt);
+    len = vsnprintf(lp->buf, POV_LOG_BUFSIZE, fmt, ap);
+    va_end(ap);
+    if (len >= 0 && len < POV_LOG_BUFSIZE) {
+	lp->used = len;
+	return;
+    }
+
+    /* longer than the whole buffer */
+    if (!bu_is_parallel())
+	pov_log_flush();
+    va_start(ap, fmt);
+    pov_log_direct(fmt, ap);
+    va_end(ap);
+}
+
+
+/* hardware counters (--counters), a group read in one go on Linux */
+#define POV_NCOUNTERS 4
+struct pov_counters {
+    uint64_t v[POV_NCOUNTERS];	/* cycles, instructions, cache and branch misses */
+};
+#ifndef POV_EMITTERS_ONLY
+static const char *counter_names[POV_NCOUNTERS] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+static int counters_enabled = 0;
+#endif /* POV_EMITTERS_ONLY */
+static int counter_fds[POV_NCOUNTERS] = {-1, -1, -1, -1};
+
+/* phases counted apart from the per type statistics */
+enum { POV_PHASE_DIRBUILD, POV_PHASE_WALK, POV_PHASE_CONVERT, POV_PHASE_WRITE, POV_PHASES };
+#ifndef POV_EMITTERS_ONLY
+static const char *phase_names[POV_PHASES] = {"dirbuild", "walk", "convert", "write"};
+#endif /* POV_EMITTERS_ONLY */
+static struct pov_counters phases[POV_PHASES];
+
+/* with --counters the scene is buffered here and each flush is
+ * counted as a write; pov_printf() flushes at half full, so only a
+ * line longer than that is written by stdio on its own
+ */
+#define POV_SCENE_BUF 65536
+#ifndef POV_EMITTERS_ONLY
+static char scene_buf[POV_SCENE_BUF];
+#endif /* POV_EMITTERS_ONLY */
+static size_t scene_pending = 0;
+
+/* conversion statistics per primitive type, reported at the end of the run */
+struct pov_stat {
+    size_t count;
+    int64_t total;	/* microseconds, less any nested submodel walks */
+    int64_t max;
+    size_t bytes;	/* scene text written */
+    size_t verts;	/* mesh vertices and faces written */
+    size_t faces;
+    struct pov_counters ctr;	/* like total, less nested walks */
+};
+#define POV_STAT_REGION (ID_MAXIMUM + 1)	/* region_start and the clines it flushes */
+static struct pov_stat stats[POV_STAT_REGION + 1];
+
+/* running totals, sampled around each conversion */
+static size_t pov_bytes = 0;
+static size_t pov_verts = 0;
+static size_t pov_faces = 0;
+
+/* share of the current conversion already claimed by nested ones */
+static struct pov_stat stats_inner;
+static int stats_depth = 0;	/* conversions under way */
+
+#ifndef POV_EMITTERS_ONLY
+/* written as JSON at the end of the run (--stats-json) */
+static const char *stats_json = NULL;
+#endif /* POV_EMITTERS_ONLY */
+
+struct pov_frame {
+    int64_t start;
+    size_t bytes;
+    size_t verts;
+    size_t faces;
+    struct pov_counters ctr;
+    struct pov_stat inner;
+};
+
+
+#ifndef POV_EMITTERS_ONLY
+/**
+ * @brief Open the --counters group for this thread: user mode cycles,
+ * instructions, cache misses and branch misses.  Without perf events
+ * the counters stay closed and read as zero.
+ */
+static void
+pov_counters_open(void)
+{
+#ifdef __linux__
+    static const uint64_t config[POV_NCOUNTERS] = {
+	PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    struct perf_event_attr attr;
+    int i;
+
+    for (i = 0; i < POV_NCOUNTERS; i++) {
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config[i];
+	attr.disabled = (i == 0);
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP;
+	counter_fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, i ? counter_fds[0] : -1, 0);
+	if (counter_fds[i] < 0) {
+	    bu_log("g-pov: unable to open the %s counter (%s), hardware counters disabled\n", counter_names[i], strerror(errno));
+	    while (i-- > 0) {
+		close(counter_fds[i]);
+		counter_fds[i] = -1;
+	    }
+	    return;
+	}
+    }
+    ioctl(counter_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+    bu_log("g-pov: hardware counters need Linux perf events, --counters ignored\n");
+#endif
+}
+
+
+static void
+pov_counters_close(void)
+{
+    int i;
+
+    for (i = 0; i < POV_NCOUNTERS; i++) {
+	if (counter_fds[i] >= 0)
+	    close(counter_fds[i]);
+	counter_fds[i] = -1;
+    }
+}
+#endif /* POV_EMITTERS_ONLY */
+
+
+static void
+pov_counters_read(struct pov_counters *cp)
+{
+    uint64_t buf[POV_NCOUNTERS + 1];	/* count, then the values */
+
+    if (counter_fds[0] < 0 || read(counter_fds[0], buf, sizeof(buf)) != (ssize_t)sizeof(buf)) {
+	memset(cp, 0, sizeof(*cp));
+	return;
+    }
+    memcpy(cp->v, buf + 1, sizeof(cp->v));
+}
+
+
+/**
+ * @brief Add what the counters have gone up by since start to sum.
+ */
+static void
+pov_counters_add(struct pov_counters *sum, const struct pov_counters *start)
+{
+    struct pov_counters now;
+    int i;
+
+    if (counter_fds[0] < 0)
+	return;
+    pov_counters_read(&now);
+    for (i = 0; i < POV_NCOUNTERS; i++)
+	sum->v[i] += now.v[i] - start->v[i];
+}
+
+
+/**
+ * @brief Write out the buffered scene, counted as the write phase.
+ */
+static void
+pov_scene_flush(void)
+{
+    struct pov_counters start;
+
+    pov_counters_read(&start);
+    fflush(stdout);
+    pov_counters_add(&phases[POV_PHASE_WRITE], &start);
+    scene_pending = 0;
+}
+
+
+/* material of the primitive being converted, declared by pov_mat_use() */
+static const struct mater_info *mat_pending = NULL;
+
+
+/**
+ * @brief Declare the pending primitive's material, once it writes something.
+ */
+static void
+pov_mat_use(void)
+{
+    const struct mater_info *mp = mat_pending;
+
+    if (!mp)
+	return;
+    mat_pending = NULL;
+    pov_material(mp);
+}
+
+
+/**
+ * @brief printf() to the scene, counting what is written.
  *
- * 
- * This routine just produces an ascii description of the Boolean tree.
- * In a real converter, this would output the tree in the desired format.
+ * The first text a primitive writes declares its material ahead of it.
  */
-void
-describe_tree(union tree *tree,
-	      struct bu_vls *str)
+static int
+pov_printf(const char *fmt, ...)
 {
-    struct bu_vls left = BU_VLS_INIT_ZERO;
-    struct bu_vls right = BU_VLS_INIT_ZERO;
-    const char op_xor='^';
-    char op='\0';
+    va_list ap;
+    int ret;
 
-    BU_CK_VLS(str);
+    pov_mat_use();
 
-    if (!tree) {
-	/* this tree has no members */
-	bu_vls_strcat(str, "-empty-");
+    va_start(ap, fmt);
+    ret = vprintf(fmt, ap);
+    va_end(ap);
+
+    if (ret > 0) {
+	pov_bytes += (size_t)ret;
+	if (counter_fds[0] >= 0 && (scene_pending += (size_t)ret) >= POV_SCENE_BUF / 2)
+	    pov_scene_flush();
+    }
+    return ret;
+}
+
+
+static void
+pov_stats_begin(struct pov_frame *fp)
+{
+    fp->start = bu_gettime();
+    fp->bytes = pov_bytes;
+    fp->verts = pov_verts;
+    fp->faces = pov_faces;
+    pov_counters_read(&fp->ctr);
+    fp->inner = stats_inner;
+    memset(&stats_inner, 0, sizeof(stats_inner));
+    stats_depth++;
+}
+
+
+/**
+ * @brief Charge a conversion to its type.  A submodel walk runs
+ * conversions inside another, so each one is charged only its own
+ * share and hands the whole of it back to the enclosing one.
+ */
+static void
+pov_stats_end(struct pov_frame *fp, int type)
+{
+    struct pov_stat all;
+    struct pov_stat *sp;
+    int i;
+
+    memset(&all.ctr, 0, sizeof(all.ctr));
+    pov_counters_add(&all.ctr, &fp->ctr);
+    all.total = bu_gettime() - fp->start;
+    all.bytes = pov_bytes - fp->bytes;
+    all.verts = pov_verts - fp->verts;
+    all.faces = pov_faces - fp->faces;
+
+    if (type >= 0 && type <= POV_STAT_REGION) {
+	int64_t self = all.total - stats_inner.total;
+
+	sp = &stats[type];
+	sp->count++;
+	sp->total += self;
+	if (self > sp->max)
+	    sp->max = self;
+	sp->bytes += all.bytes - stats_inner.bytes;
+	sp->verts += all.verts - stats_inner.verts;
+	sp->faces += all.faces - stats_inner.faces;
+	for (i = 0; i < POV_NCOUNTERS; i++)
+	    sp->ctr.v[i] += all.ctr.v[i] - stats_inner.ctr.v[i];
+    }
+
+    stats_inner = fp->inner;
+    stats_inner.total += all.total;
+    stats_inner.bytes += all.bytes;
+    stats_inner.verts += all.verts;
+    stats_inner.faces += all.faces;
+    for (i = 0; i < POV_NCOUNTERS; i++)
+	stats_inner.ctr.v[i] += all.ctr.v[i];
+
+    /* the outermost conversions make up the convert phase */
+    if (--stats_depth == 0)
+	for (i = 0; i < POV_NCOUNTERS; i++)
+	    phases[POV_PHASE_CONVERT].v[i] += all.ctr.v[i];
+}
+
+
+static const char *
+pov_stats_label(int type)
+{
+    return (type == POV_STAT_REGION) ? "region" : OBJ[type].ft_label;
+}
+
+
+#ifndef POV_EMITTERS_ONLY
+static int
+pov_stats_cmp(const void *a, const void *b)
+{
+    const struct pov_stat *sa = &stats[*(const int *)a];
+    const struct pov_stat *sb = &stats[*(const int *)b];
+
+    if (sa->total != sb->total)
+	return (sa->total < sb->total) ? 1 : -1;
+    return *(const int *)a - *(const int *)b;
+}
+
+
+static double
+pov_ipc(const struct pov_counters *cp)
+{
+    return cp->v[0] ? (double)cp->v[1] / cp->v[0] : 0.0;
+}
+
+
+/**
+ * @brief Log the conversion profile, slowest type first, and write it
+ * to the --stats-json file when one was given.  With --counters, the
+ * phases and the IPC and misses per primitive are added.
+ */
+static void
+pov_stats_report(void)
+{
+    int order[POV_STAT_REGION + 1];
+    int i, n = 0;
+    FILE *fp = NULL;
+
+    for (i = 0; i <= POV_STAT_REGION; i++)
+	if (stats[i].count)
+	    order[n++] = i;
+    qsort(order, n, sizeof(int), pov_stats_cmp);
+
+    bu_log("%-10s %10s %12s %10s %12s %10s %10s\n", "type", "count", "total ms", "max ms", "bytes", "verts", "faces");
+    for (i = 0; i < n; i++) {
+	const struct pov_stat *sp = &stats[order[i]];
+	bu_log("%-10s %10lu %12.3f %10.3f %12lu %10lu %10lu\n", pov_stats_label(order[i]),
+	       (unsigned long)sp->count, sp->total / 1000.0, sp->max / 1000.0,
+	       (unsigned long)sp->bytes, (unsigned long)sp->verts, (unsigned long)sp->faces);
+    }
+
+    if (counter_fds[0] >= 0) {
+	bu_log("\n%-10s %14s %14s %6s %12s %12s\n", "phase", "cycles", "instructions", "IPC", "cache miss", "branch miss");
+	for (i = 0; i < POV_PHASES; i++)
+	    bu_log("%-10s %14llu %14llu %6.2f %12llu %12llu\n", phase_names[i],
+		   (unsigned long long)phases[i].v[0], (unsigned long long)phases[i].v[1], pov_ipc(&phases[i]),
+		   (unsigned long long)phases[i].v[2], (unsigned long long)phases[i].v[3]);
+	bu_log("\n%-10s %6s %16s %16s\n", "type", "IPC", "cache miss/each", "branch miss/each");
+	for (i = 0; i < n; i++) {
+	    const struct pov_stat *sp = &stats[order[i]];
+	    bu_log("%-10s %6.2f %16.1f %16.1f\n", pov_stats_label(order[i]), pov_ipc(&sp->ctr),
+		   (double)sp->ctr.v[2] / sp->count, (double)sp->ctr.v[3] / sp->count);
+	}
+    }
+
+    if (!stats_json)
+	return;
+    if ((fp = fopen(stats_json, "w")) == NULL) {
+	perror(stats_json);
+	bu_log("g-pov: unable to write statistics to %s\n", stats_json);
 	return;
     }
+    fprintf(fp, "{\n  \"bytes\": %lu,\n  \"types\": [", (unsigned long)pov_bytes);
+    for (i = 0; i < n; i++) {
+	const struct pov_stat *sp = &stats[order[i]];
+	fprintf(fp, "%s\n    {\"type\": \"%s\", \"count\": %lu, \"total_us\": %lld, \"max_us\": %lld, "
+		"\"bytes\": %lu, \"verts\": %lu, \"faces\": %lu",
+		i ? "," : "", pov_stats_label(order[i]), (unsigned long)sp->count,
+		(long long)sp->total, (long long)sp->max,
+		(unsigned long)sp->bytes, (unsigned long)sp->verts, (unsigned long)sp->faces);
+	if (counter_fds[0] >= 0)
+	    fprintf(fp, ", \"ipc\": %.3f, \"cycles\": %llu, \"instructions\": %llu, \"cache_misses\": %llu, \"branch_misses\": %llu}",
+		    pov_ipc(&sp->ctr), (unsigned long long)sp->ctr.v[0], (unsigned long long)sp->ctr.v[1],
+		    (unsigned long long)sp->ctr.v[2], (unsigned long long)sp->ctr.v[3]);
+	else
+	    fputc('}', fp);
+    }
+    fprintf(fp, "\n  ]");
+    if (counter_fds[0] >= 0) {
+	fprintf(fp, ",\n  \"phases\": [");
+	for (i = 0; i < POV_PHASES; i++)
+	    fprintf(fp, "%s\n    {\"phase\": \"%s\", \"ipc\": %.3f, \"cycles\": %llu, \"instructions\": %llu, "
+		    "\"cache_misses\": %llu, \"branch_misses\": %llu}", i ? "," : "", phase_names[i], pov_ipc(&phases[i]),
+		    (unsigned long long)phases[i].v[0], (unsigned long long)phases[i].v[1],
+		    (unsigned long long)phases[i].v[2], (unsigned long long)phases[i].v[3]);
+	fprintf(fp, "\n  ]");
+    }
+    fprintf(fp, "\n}\n");
+    fclose(fp);
+}
+#endif /* POV_EMITTERS_ONLY */
 
-    RT_CK_TREE(tree);
-    /**
-     *@brief Different node handler.
-     *
-     * 
-     * Handle all the possible node types.
-     * the first four are the most common types, and are typically
-     * the only ones found in a BRL-CAD database.
-     */
-    switch (tree->tr_op) {
-	case OP_DB_LEAF:	
-		/**
-		 *@brief leaf node, this is a member 
-		 *
-		 *
-	     * Note: tree->tr_l.tl_mat is a pointer to a
-	     * transformation matrix to apply to this member
-	     */
-	    bu_vls_strcat(str,  tree->tr_l.tl_name);
-	    break;
-	case OP_UNION:		/* union operator node */
-	    op = DB_OP_UNION;
-	    goto binary;
-	case OP_INTERSECT:	/* intersection operator node */
-	    op = DB_OP_INTERSECT;
-	    goto binary;
-	case OP_SUBTRACT:	/* subtraction operator node */
-	    op = DB_OP_SUBTRACT;
-	    goto binary;
-	case OP_XOR:		/* exclusive "or" operator node */
-	    op = op_xor;
-	binary:				/* common for all binary nodes */
-	    describe_tree(tree->tr_b.tb_left, &left);
-	    describe_tree(tree->tr_b.tb_right, &right);
-	    bu_vls_putc(str, '(');
-	    bu_vls_vlscatzap(str, &left);
-	    bu_vls_printf(str, " %c ", op);
-	    bu_vls_vlscatzap(str, &right);
-	    bu_vls_putc(str, ')');
-	    break;
-	case OP_NOT:
-	    bu_vls_strcat(str, "(!");
-	    describe_tree(tree->tr_b.tb_left, str);
-	    bu_vls_putc(str, ')');
-	    break;
-	case OP_GUARD:
-	    bu_vls_strcat(str, "(G");
-	    describe_tree(tree->tr_b.tb_left, str);
-	    bu_vls_putc(str, ')');
-	    break;
-	case OP_XNOP:
-	    bu_vls_strcat(str, "(X");
-	    describe_tree(tree->tr_b.tb_left, str);
-	    bu_vls_putc(str, ')');
-	    break;
-	case OP_NOP:
-	    bu_vls_strcat(str, "NOP");
-	    break;
-	default:
-	    bu_exit(1, "ERROR: describe_tree() got unrecognized op (%d)\n", tree->tr_op);
+
+/* Chrome trace events (--trace), written out at the end of the run */
+static const char *trace_file = NULL;
+static struct bu_vls trace_events = BU_VLS_INIT_ZERO;
+static int64_t trace_epoch = 0;
+
+/* the region whose leaves are being converted; see pov_trace_region() */
+static struct bu_vls trace_region_name = BU_VLS_INIT_ZERO;
+static int64_t trace_region_start = 0;
+
+
+static int64_t
+pov_trace_begin(void)
+{
+    return trace_file ? bu_gettime() : 0;
+}
+
+
+/**
+ * @brief Record a complete span from start until now.  Thread 0 is
+ * the tree walk, bu_parallel() workers are 1 up.
+ */
+static void
+pov_trace_end(const char *name, const char *cat, int tid, int64_t start)
+{
+    int64_t now;
+    const char *cp;
+
+    if (!trace_file)
+	return;
+    now = bu_gettime();
+
+    bu_semaphore_acquire(BU_SEM_GENERAL);
+    bu_vls_strcat(&trace_events, ",\n{\"name\": \"");
+    for (cp = name; *cp; cp++) {
+	if (*cp == '"' || *cp == '\\')
+	    bu_vls_putc(&trace_events, '\\');
+	if ((unsigned char)*cp >= ' ')
+	    bu_vls_putc(&trace_events, *cp);
+    }
+    bu_vls_printf(&trace_events, "\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %lld, \"dur\": %lld}",
+		  cat, tid, (long long)(start - trace_epoch), (long long)(now - start));
+    bu_semaphore_release(BU_SEM_GENERAL);
+}
+
+
+/**
+ * @brief End the current region's span and start one for the named
+ * region, or none for NULL.
+ *
+ * db_walk_tree() calls region_end only once the whole tree has been
+ * walked, so a region's span runs from its region_start to the next
+ * one, which is where its leaves are converted.
+ */
+static void
+pov_trace_region(const char *name)
+{
+    if (!trace_file)
+	return;
+
+    if (trace_region_start)
+	pov_trace_end(bu_vls_addr(&trace_region_name), "region", 0, trace_region_start);
+    trace_region_start = 0;
+    if (name) {
+	bu_vls_strcpy(&trace_region_name, name);
+	trace_region_start = bu_gettime();
+    }
+}
+
+
+#ifndef POV_EMITTERS_ONLY
+/* write the recorded spans as a Chrome trace-event JSON array */
+static void
+pov_trace_write(int ncpu)
+{
+    FILE *fp;
+    int i;
+
+    if (!trace_file)
+	return;
+
+    if ((fp = fopen(trace_file, "w")) == NULL) {
+	perror(trace_file);
+	bu_log("g-pov: unable to write the trace to %s\n", trace_file);
+    } else {
+	fprintf(fp, "[\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"walk\"}}");
+	for (i = 1; i <= ncpu; i++)
+	    fprintf(fp, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"worker %d\"}}", i, i);
+	fprintf(fp, "%s\n]\n", bu_vls_addr(&trace_events));
+	fclose(fp);
+    }
+
+    bu_vls_free(&trace_events);
+    bu_vls_free(&trace_region_name);
+}
+#endif /* POV_EMITTERS_ONLY */
+
+
+/* allocation profile (--allocs): bu_malloc() and friends are
+ * interposed when g-pov is built with POV_ALLOC_PROFILE and counted
+ * per call site (the label passed to them) and phase.
+ */
+enum { POV_ALLOC_DIRBUILD, POV_ALLOC_WALK, POV_ALLOC_REGION, POV_ALLOC_PRIMITIVE, POV_ALLOC_OTHER, POV_ALLOC_PHASES };
+static int allocs_enabled = 0;
+static int alloc_phase = POV_ALLOC_OTHER;
+
+#ifdef POV_ALLOC_HOOKS
+
+#ifndef POV_EMITTERS_ONLY
+static const char *alloc_phase_names[POV_ALLOC_PHASES] = {"dirbuild", "walk", "region", "primitive", "other"};
+#endif /* POV_EMITTERS_ONLY */
+
+#define POV_ALLOC_SITES 1024	/* more labels than this are charged to "(other)" */
+#define POV_ALLOC_TOP 10	/* regions listed by peak live bytes */
+
+struct pov_alloc_site {
+    const char *label;	/* as passed, the key */
+    char name[64];	/* copied, the label may not outlive the run */
+    size_t count[POV_ALLOC_PHASES];
+    size_t bytes[POV_ALLOC_PHASES];
+    size_t frees;
+};
+static struct pov_alloc_site alloc_sites[POV_ALLOC_SITES + 1];	/* and "(other)" */
+
+/* live blocks and their sizes, open addressing on the pointer */
+struct pov_alloc_block {
+    void *ptr;
+    size_t size;
+};
+static struct pov_alloc_block *alloc_blocks = NULL;
+static size_t alloc_nblocks = 0;
+static size_t alloc_maxblocks = 0;
+static size_t alloc_live = 0;
+static size_t alloc_peak = 0;
+
+/* the region being converted and the largest regions seen */
+struct pov_alloc_region {
+    char name[128];
+    size_t peak;	/* live bytes above those at region_start */
+};
+static struct pov_alloc_region alloc_region;
+static size_t alloc_region_base = 0;
+static size_t alloc_region_peak = 0;
+static struct pov_alloc_region alloc_top[POV_ALLOC_TOP];
+
+
+static size_t
+pov_alloc_hash(const void *ptr, size_t n)
+{
+    return (size_t)(((uintptr_t)ptr >> 4) * 2654435761u) & (n - 1);
+}
+
+
+static struct pov_alloc_site *
+pov_alloc_site(const char *label)
+{
+    static const char null_label[] = "(null)";
+    struct pov_alloc_site *sp;
+    size_t i, k;
+
+    if (!label)
+	label = null_label;
+
+    k = pov_alloc_hash(label, POV_ALLOC_SITES);
+    for (i = 0; i < POV_ALLOC_SITES; i++, k = (k + 1) & (POV_ALLOC_SITES - 1)) {
+	sp = &alloc_sites[k];
+	if (sp->label == label)
+	    return sp;
+	if (!sp->label) {
+	    sp->label = label;
+	    snprintf(sp->name, sizeof(sp->name), "%s", label);
+	    return sp;
+	}
+    }
+
+    /* the table is full, the rest share the entry past its end */
+    sp = &alloc_sites[POV_ALLOC_SITES];
+    if (!sp->name[0])
+	snprintf(sp->name, sizeof(sp->name), "(other)");
+    return sp;
+}
+
+
+/* the table uses the C library directly, bu_malloc() would recurse */
+static void
+pov_alloc_grow(void)
+{
+    struct pov_alloc_block *old = alloc_blocks;
+    size_t i, oldmax = alloc_maxblocks;
+
+    alloc_maxblocks = oldmax ? oldmax * 2 : 4096;
+    alloc_blocks = (struct pov_alloc_block *)calloc(alloc_maxblocks, sizeof(struct pov_alloc_block));
+    for (i = 0; i < oldmax; i++) {
+	if (old[i].ptr) {
+	    size_t k = pov_alloc_hash(old[i].ptr, alloc_maxblocks);
+	    while (alloc_blocks[k].ptr)
+		k = (k + 1) & (alloc_maxblocks - 1);
+	    alloc_blocks[k] = old[i];
+	}
+    }
+    free(old);
+}
+
+
+static void
+pov_alloc_add(void *ptr, size_t size, const char *label)
+{
+    struct pov_alloc_site *sp;
+    size_t k;
+
+    if (!ptr)
+	return;
+
+    bu_semaphore_acquire(BU_SEM_MALLOC);
+    sp = pov_alloc_site(label);
+    sp->count[alloc_phase]++;
+    sp->bytes[alloc_phase] += size;
+
+    if (2 * (alloc_nblocks + 1) > alloc_maxblocks)
+	pov_alloc_grow();
+    if (alloc_blocks) {
+	k = pov_alloc_hash(ptr, alloc_maxblocks);
+	while (alloc_blocks[k].ptr)
+	    k = (k + 1) & (alloc_maxblocks - 1);
+	alloc_blocks[k].ptr = ptr;
+	alloc_blocks[k].size = size;
+	alloc_nblocks++;
+	alloc_live += size;
+	if (alloc_live > alloc_peak)
+	    alloc_peak = alloc_live;
+	if (alloc_live > alloc_region_peak)
+	    alloc_region_peak = alloc_live;
+    }
+    bu_semaphore_release(BU_SEM_MALLOC);
+}
+
+
+/**
+ * @brief Forget a freed block.  Blocks allocated before --allocs took
+ * effect are not in the table and are ignored.
+ */
+static void
+pov_alloc_remove(void *ptr, const char *label)
+{
+    size_t k, j;
+
+    if (!ptr)
+	return;
+
+    bu_semaphore_acquire(BU_SEM_MALLOC);
+    if (label)
+	pov_alloc_site(label)->frees++;
+    if (!alloc_maxblocks) {
+	bu_semaphore_release(BU_SEM_MALLOC);
+	return;
+    }
+
+    k = pov_alloc_hash(ptr, alloc_maxblocks);
+    while (alloc_blocks[k].ptr && alloc_blocks[k].ptr != ptr)
+	k = (k + 1) & (alloc_maxblocks - 1);
+    if (alloc_blocks[k].ptr) {
+	alloc_live -= alloc_blocks[k].size;
+	alloc_nblocks--;
+	alloc_blocks[k].ptr = NULL;
+
+	/* close the gap so later probes still find their blocks */
+	for (j = (k + 1) & (alloc_maxblocks - 1); alloc_blocks[j].ptr; j = (j + 1) & (alloc_maxblocks - 1)) {
+	    size_t home = pov_alloc_hash(alloc_blocks[j].ptr, alloc_maxblocks);
+	    if (((j - home) & (alloc_maxblocks - 1)) >= ((j - k) & (alloc_maxblocks - 1))) {
+		alloc_blocks[k] = alloc_blocks[j];
+		alloc_blocks[j].ptr = NULL;
+		k = j;
+	    }
+	}
+    }
+    bu_semaphore_release(BU_SEM_MALLOC);
+}
+
+
+/**
+ * @brief Start charging live memory to the region named, or to none
+ * when name is NULL, ranking the one that ends by its peak.
+ */
+static void
+pov_alloc_region(const char *name)
+{
+    int i;
+
+    if (!allocs_enabled)
+	return;
+
+    bu_semaphore_acquire(BU_SEM_MALLOC);
+    if (alloc_region.name[0]) {
+	alloc_region.peak = alloc_region_peak - alloc_region_base;
+	for (i = POV_ALLOC_TOP; i > 0 && alloc_top[i - 1].peak < alloc_region.peak; i--)
+	    if (i < POV_ALLOC_TOP)
+		alloc_top[i] = alloc_top[i - 1];
+	if (i < POV_ALLOC_TOP)
+	    alloc_top[i] = alloc_region;
+    }
+    alloc_region.name[0] = '\0';
+    if (name)
+	snprintf(alloc_region.name, sizeof(alloc_region.name), "%s", name);
+    alloc_region_base = alloc_region_peak = alloc_live;
+    bu_semaphore_release(BU_SEM_MALLOC);
+}
+
+
+/* the libbu allocator, found the first time one is needed */
+static void *(*real_bu_malloc)(size_t, const char *) = NULL;
+static void *(*real_bu_calloc)(size_t, size_t, const char *) = NULL;
+static void *(*real_bu_realloc)(void *, size_t, const char *) = NULL;
+static void (*real_bu_free)(void *, const char *) = NULL;
+
+static void
+pov_alloc_hooks(void)
+{
+    *(void **)(&real_bu_malloc) = dlsym(RTLD_NEXT, "bu_malloc");
+    *(void **)(&real_bu_calloc) = dlsym(RTLD_NEXT, "bu_calloc");
+    *(void **)(&real_bu_realloc) = dlsym(RTLD_NEXT, "bu_realloc");
+    *(void **)(&real_bu_free) = dlsym(RTLD_NEXT, "bu_free");
+    if (!real_bu_malloc || !real_bu_calloc || !real_bu_realloc || !real_bu_free) {
+	fprintf(stderr, "g-pov: the libbu allocator is not in a shared library, unable to profile allocations\n");
+	exit(1);
+    }
+}
+
+
+void *
+bu_malloc(size_t siz, const char *str)
+{
+    void *ptr;
+
+    if (!real_bu_malloc)
+	pov_alloc_hooks();
+    ptr = real_bu_malloc(siz, str);
+    if (allocs_enabled)
+	pov_alloc_add(ptr, siz, str);
+    return ptr;
+}
+
+
+void *
+bu_calloc(size_t nelem, size_t elsize, const char *str)
+{
+    void *ptr;
+
+    if (!real_bu_calloc)
+	pov_alloc_hooks();
+    ptr = real_bu_calloc(nelem, elsize, str);
+    if (allocs_enabled)
+	pov_alloc_add(ptr, nelem * elsize, str);
+    return ptr;
+}
+
+
+void *
+bu_realloc(void *ptr, size_t siz, const char *str)
+{
+    void *newptr;
+
+    if (!real_bu_realloc)
+	pov_alloc_hooks();
+    if (allocs_enabled)
+	pov_alloc_remove(ptr, NULL);
+    newptr = real_bu_realloc(ptr, siz, str);
+    if (allocs_enabled)
+	pov_alloc_add(newptr, siz, str);
+    return newptr;
+}
+
+
+void
+bu_free(void *ptr, const char *str)
+{
+    if (!real_bu_free)
+	pov_alloc_hooks();
+    if (allocs_enabled)
+	pov_alloc_remove(ptr, str);
+    real_bu_free(ptr, str);
+}
+
+
+struct pov_alloc_row {
+    const struct pov_alloc_site *site;
+    int phase;
+};
+
+#ifndef POV_EMITTERS_ONLY
+static int
+pov_alloc_cmp(const void *a, const void *b)
+{
+    const struct pov_alloc_row *ra = (const struct pov_alloc_row *)a;
+    const struct pov_alloc_row *rb = (const struct pov_alloc_row *)b;
+    size_t ba = ra->site->bytes[ra->phase], bb = rb->site->bytes[rb->phase];
+
+    if (ba != bb)
+	return (ba < bb) ? 1 : -1;
+    return (ra->site->count[ra->phase] < rb->site->count[rb->phase]) ? 1 : -1;
+}
+
+
+/**
+ * @brief Log the allocations by phase and by call site and phase,
+ * most bytes first, and the regions with the largest peaks.
+ */
+static void
+pov_alloc_report(void)
+{
+    struct pov_alloc_row *rows;
+    size_t i, n = 0, count, bytes;
+    int p;
+
+    if (!allocs_enabled)
+	return;
+    pov_alloc_region(NULL);
+    allocs_enabled = 0;	/* the report allocates too */
+
+    bu_log("\n%-10s %12s %14s %10s\n", "phase", "allocs", "bytes", "bytes/each");
+    for (p = 0; p < POV_ALLOC_PHASES; p++) {
+	count = bytes = 0;
+	for (i = 0; i <= POV_ALLOC_SITES; i++) {
+	    count += alloc_sites[i].count[p];
+	    bytes += alloc_sites[i].bytes[p];
+	}
+	bu_log("%-10s %12lu %14lu %10.1f\n", alloc_phase_names[p], (unsigned long)count,
+	       (unsigned long)bytes, count ? (double)bytes / count : 0.0);
+    }
+
+    rows = (struct pov_alloc_row *)calloc((POV_ALLOC_SITES + 1) * POV_ALLOC_PHASES, sizeof(struct pov_alloc_row));
+    for (i = 0; i <= POV_ALLOC_SITES; i++)
+	for (p = 0; p < POV_ALLOC_PHASES; p++)
+	    if (alloc_sites[i].count[p]) {
+		rows[n].site = &alloc_sites[i];
+		rows[n++].phase = p;
+	    }
+    qsort(rows, n, sizeof(struct pov_alloc_row), pov_alloc_cmp);
+
+    bu_log("\n%-32s %-10s %12s %14s %10s\n", "site", "phase", "allocs", "bytes", "frees");
+    for (i = 0; i < n; i++)
+	bu_log("%-32s %-10s %12lu %14lu %10lu\n", rows[i].site->name, alloc_phase_names[rows[i].phase],
+	       (unsigned long)rows[i].site->count[rows[i].phase], (unsigned long)rows[i].site->bytes[rows[i].phase],
+	       (unsigned long)rows[i].site->frees);
+    free(rows);
+
+    bu_log("\npeak live bytes %lu, still live %lu in %lu blocks\n", (unsigned long)alloc_peak,
+	   (unsigned long)alloc_live, (unsigned long)alloc_nblocks);
+    for (i = 0; i < POV_ALLOC_TOP && alloc_top[i].name[0]; i++)
+	bu_log("%14lu %s\n", (unsigned long)alloc_top[i].peak, alloc_top[i].name);
+
+    free(alloc_blocks);
+    alloc_blocks = NULL;
+    alloc_nblocks = alloc_maxblocks = 0;
+}
+#endif /* POV_EMITTERS_ONLY */
+
+#else
+
+static void
+pov_alloc_region(const char *UNUSED(name))
+{
+}
+
+
+#ifndef POV_EMITTERS_ONLY
+static void
+pov_alloc_report(void)
+{
+}
+#endif /* POV_EMITTERS_ONLY */
+
+#endif /* POV_ALLOC_HOOKS */
+
+
+/* region and primitive callbacks captured (--record) for pov_replay() */
+#ifndef POV_EMITTERS_ONLY
+static const char *record_file = NULL;
+static const char *replay_file = NULL;
+#endif /* POV_EMITTERS_ONLY */
+static FILE *capture = NULL;
+static int submodel_depth = 0;	/* within a submodel walk: not captured, scratch kept */
+
+#define POV_CAPTURE_MAGIC "g-pov capture 1\n"
+#define POV_CAPTURE_MAGIC_LEN 16
+#define POV_CAPTURE_DOUBLES 19	/* ts_mat and ma_color */
+
+
+static void
+pov_capture_long(size_t val)
+{
+    unsigned char buf[4];
+
+    bu_plong(buf, (uint32_t)val);
+    fwrite(buf, 4, 1, capture);
+}
+
+
+static void
+pov_capture_string(const char *str)
+{
+    size_t len = str ? strlen(str) : 0;
+
+    pov_capture_long(len);
+    if (len)
+	fwrite(str, len, 1, capture);
+}
+
+
+/**
+ * @brief Append one callback to the --record capture: its kind ('R'
+ * region or 'P' primitive), path, matrix, material and the object as
+ * the v5 record librt would write for it.  Regions are stored as
+ * their combination.
+ */
+static void
+pov_capture(int kind, const struct db_tree_state *tsp, const struct db_full_path *pathp, const struct rt_db_internal *ip)
+{
+    struct bu_external ext;
+    struct directory *dp;
+    unsigned char buf[POV_CAPTURE_DOUBLES * 8];
+    double d[POV_CAPTURE_DOUBLES];
+    char *path;
+    int i;
+
+    if (!capture || submodel_depth > 0)
+	return;
+
+    dp = DB_FULL_PATH_CUR_DIR(pathp);
+    BU_EXTERNAL_INIT(&ext);
+    if (rt_db_cvt_to_external5(&ext, dp->d_namep, ip, 1.0, tsp->ts_dbip,
+			       tsp->ts_resp ? tsp->ts_resp : &rt_uniresource, ip->idb_major_type) < 0) {
+	bu_log("g-pov: unable to record %s, skipped\n", dp->d_namep);
+	return;
+    }
+
+    for (i = 0; i < 16; i++)
+	d[i] = tsp->ts_mat[i];
+    for (i = 0; i < 3; i++)
+	d[16 + i] = tsp->ts_mater.ma_color[i];
+    htond(buf, (const unsigned char *)d, POV_CAPTURE_DOUBLES);
+
+    path = db_path_to_string(pathp);
+    fputc(kind, capture);
+    pov_capture_string(path);
+    fwrite(buf, sizeof(buf), 1, capture);
+    fputc(tsp->ts_mater.ma_color_valid ? 1 : 0, capture);
+    pov_capture_string(tsp->ts_mater.ma_shader);
+    pov_capture_long(ip->idb_major_type);
+    pov_capture_long(ext.ext_nbytes);
+    fwrite(ext.ext_buf, ext.ext_nbytes, 1, capture);
+    bu_free(path, "capture path");
+
+    bu_free_external(&ext);
+}
+
+
+/**
+ * @brief Capture a region_start() callback, wrapping the combination
+ * in the internal form librt exports.
+ */
+static void
+pov_capture_region(const struct db_tree_state *tsp, const struct db_full_path *pathp, const struct rt_comb_internal *combp)
+{
+    struct rt_db_internal intern;
+
+    if (!capture || submodel_depth > 0)
+	return;
+
+    RT_DB_INTERNAL_INIT(&intern);
+    intern.idb_major_type = DB5_MAJORTYPE_BRLCAD;
+    intern.idb_type = ID_COMBINATION;
+    intern.idb_meth = &OBJ[ID_COMBINATION];
+    intern.idb_ptr = (void *)combp;
+    pov_capture('R', tsp, pathp, &intern);
+}
+
+
+#ifndef POV_EMITTERS_ONLY
+/**
+ * @brief Take the long options out of argv before bu_getopt() sees
+ * it.  Each takes a file name, as "--name file" or "--name=file",
+ * except the flags, which set an int.  Returns -1 when one is missing
+ * its argument.
+ */
+static int
+pov_long_opts(int *argc, char *argv[])
+{
+    static const struct {
+	const char *name;
+	const char **value;
+	int *flag;
+    } opts[] = {
+	{"--stats-json", &stats_json, NULL},
+	{"--trace", &trace_file, NULL},
+	{"--record", &record_file, NULL},
+	{"--replay", &replay_file, NULL},
+	{"--counters", NULL, &counters_enabled},
+	{"--allocs", NULL, &allocs_enabled}
+    };
+    int i, n = 1;
+    size_t k, len;
+
+    for (i = 1; i < *argc; i++) {
+	if (BU_STR_EQUAL(argv[i], "--")) {
+	    while (i < *argc)
+		argv[n++] = argv[i++];
+	    break;
+	}
+	for (k = 0; k < sizeof(opts) / sizeof(opts[0]); k++) {
+	    len = strlen(opts[k].name);
+	    if (opts[k].flag) {
+		if (BU_STR_EQUAL(argv[i], opts[k].name)) {
+		    *opts[k].flag = 1;
+		    break;
+		}
+		continue;
+	    }
+	    if (BU_STR_EQUAL(argv[i], opts[k].name)) {
+		if (++i >= *argc)
+		    return -1;
+		*opts[k].value = argv[i];
+		break;
+	    }
+	    if (!bu_strncmp(argv[i], opts[k].name, len) && argv[i][len] == '=') {
+		*opts[k].value = argv[i] + len + 1;
+		break;
+	    }
+	}
+	if (k == sizeof(opts) / sizeof(opts[0]))
+	    argv[n++] = argv[i];
+    }
+    *argc = n;
+    argv[n] = NULL;
+    return 0;
+}
+#endif /* POV_EMITTERS_ONLY */
+
+
+/* scratch memory: bump arenas released all at once.  The walking
+ * thread has one for each region (path names, face buffers and the
+ * like), reset as the region starts, and each bu_parallel() worker
+ * has its own, reset as the worker starts.  What does not fit in an
+ * arena's buffer goes to blocks of its own, and the next reset grows
+ * the buffer to the most that was in use at once, so a steady walk
+ * makes no allocations for either
+ */
+struct pov_scratch_block {
+    struct pov_scratch_block *next;
+    size_t size;
+};
+#define POV_SCRATCH_ALIGN 16
+#define POV_SCRATCH_HEADER ((sizeof(struct pov_scratch_block) + POV_SCRATCH_ALIGN - 1) & ~(size_t)(POV_SCRATCH_ALIGN - 1))
+
+struct pov_arena {
+    char *buf;
+    size_t size;
+    size_t used;
+    struct pov_scratch_block *overflow;	/* taken when buf ran out, newest first */
+    size_t overflow_bytes;
+    size_t peak;	/* most of used and overflow_bytes at once since the reset */
+};
+
+/* where an arena stood, for pov_arena_release() */
+struct pov_arena_mark {
+    size_t used;
+    struct pov_scratch_block *overflow;
+};
+
+static struct pov_arena scratch;	/* the walking thread's, per region */
+static struct pov_arena worker_scratch[MAX_PSW];	/* by bu_parallel() cpu */
+
+
+/**
+ * @brief Arena memory that lasts until the next pov_arena_reset(), or
+ * pov_arena_release() back past it.
+ */
+static void *
+pov_arena_alloc(struct pov_arena *ap, size_t n)
+{
+    struct pov_scratch_block *bp;
+    void *ptr;
+
+    n = (n + POV_SCRATCH_ALIGN - 1) & ~(size_t)(POV_SCRATCH_ALIGN - 1);
+    if (ap->used + n <= ap->size) {
+	ptr = ap->buf + ap->used;
+	ap->used += n;
+    } else {
+	/* out of room until the reset, which makes buf big enough */
+	bp = (struct pov_scratch_block *)bu_malloc(POV_SCRATCH_HEADER + n, "pov_scratch overflow");
+	bp->next = ap->overflow;
+	bp->size = n;
+	ap->overflow = bp;
+	ap->overflow_bytes += n;
+	ptr = (char *)bp + POV_SCRATCH_HEADER;
+    }
+
+    if (ap->used + ap->overflow_bytes > ap->peak)
+	ap->peak = ap->used + ap->overflow_bytes;
+    return ptr;
+}
+
+
+static void
+pov_arena_mark(const struct pov_arena *ap, struct pov_arena_mark *mp)
+{
+    mp->used = ap->used;
+    mp->overflow = ap->overflow;
+}
+
+
+/**
+ * @brief Give back everything taken from ap since the mark, freeing
+ * the overflow blocks among it.
+ */
+static void
+pov_arena_release(struct pov_arena *ap, const struct pov_arena_mark *mp)
+{
+    while (ap->overflow != mp->overflow) {
+	struct pov_scratch_block *next = ap->overflow->next;
+	ap->overflow_bytes -= ap->overflow->size;
+	bu_free(ap->overflow, "pov_scratch overflow");
+	ap->overflow = next;
+    }
+    ap->used = mp->used;
+}
+
+
+/**
+ * @brief Release all of ap at once, growing its buffer to the most
+ * that was in use at once when that did not fit.
+ */
+static void
+pov_arena_reset(struct pov_arena *ap)
+{
+    struct pov_arena_mark empty = {0, NULL};
+
+    pov_arena_release(ap, &empty);
+    if (ap->peak > ap->size) {
+	if (ap->buf)
+	    bu_free(ap->buf, "pov_scratch");
+	ap->size = (ap->peak > 4096) ? ap->peak : 4096;
+	ap->buf = (char *)bu_malloc(ap->size, "pov_scratch");
+    }
+    ap->peak = 0;
+}
+
+
+/**
+ * @brief Scratch memory that lasts until the next pov_scratch_reset().
+ */
+static void *
+pov_scratch(size_t n)
+{
+    return pov_arena_alloc(&scratch, n);
+}
+
+
+/**
+ * @brief Release all scratch memory at once.  Within a submodel's walk
+ * the enclosing primitive's scratch is still in use, so nothing is
+ * released there.
+ */
+static void
+pov_scratch_reset(void)
+{
+    if (submodel_depth > 0)
+	return;
+    pov_arena_reset(&scratch);
+}
+
+
+#ifndef POV_EMITTERS_ONLY
+static void
+pov_arena_free(struct pov_arena *ap)
+{
+    pov_arena_reset(ap);
+    if (ap->buf)
+	bu_free(ap->buf, "pov_scratch");
+    ap->buf = NULL;
+    ap->size = ap->used = 0;
+}
+
+
+static void
+pov_scratch_free(void)
+{
+    int i;
+
+    pov_scratch_reset();
+    pov_arena_free(&scratch);
+    for (i = 0; i < MAX_PSW; i++)
+	pov_arena_free(&worker_scratch[i]);
+}
+#endif /* POV_EMITTERS_ONLY */
+
+
+/**
+ * @brief db_path_to_string() into scratch memory.
+ */
+static char *
+pov_scratch_path(const struct db_full_path *pathp)
+{
+    size_t i, len = 1;
+    char *str, *cp;
+
+    for (i = 0; i < pathp->fp_len; i++)
+	len += strlen(DB_FULL_PATH_GET(pathp, i)->d_namep) + 1;
+
+    cp = str = (char *)pov_scratch(len);
+    for (i = 0; i < pathp->fp_len; i++) {
+	const char *name = DB_FULL_PATH_GET(pathp, i)->d_namep;
+	size_t n = strlen(name);
+	*cp++ = '/';
+	memcpy(cp, name, n);
+	cp += n;
+    }
+    *cp = '\0';
+    return str;
+}
+
+
+/**
+ * @brief describe_tree
+ *
+ * 
+ * This routine just produces an ascii description of the Boolean tree.
+ * In a real converter, this would output the tree in the desired format.
+ */
+void
+describe_tree(union tree *tree,
+	      struct bu_vls *str)
+{
+    const char op_xor='^';
+    char op='\0';
+
+    BU_CK_VLS(str);
+
+    if (!tree) {
+	/* this tree has no members */
+	bu_vls_strcat(str, "-empty-");
+	return;
+    }
+
+    RT_CK_TREE(tree);
+    /**
+     *@brief Different node handler.
+     *
+     * 
+     * Handle all the possible node types.
+     * the first four are the most common types, and are typically
+     * the only ones found in a BRL-CAD database.
+     */
+    switch (tree->tr_op) {
+	case OP_DB_LEAF:	
+		/**
+		 *@brief leaf node, this is a member 
+		 *
+		 *
+	     * Note: tree->tr_l.tl_mat is a pointer to a
+	     * transformation matrix to apply to this member
+	     */
+	    bu_vls_strcat(str,  tree->tr_l.tl_name);
+	    break;
+	case OP_UNION:		/* union operator node */
+	    op = DB_OP_UNION;
+	    goto binary;
+	case OP_INTERSECT:	/* intersection operator node */
+	    op = DB_OP_INTERSECT;
+	    goto binary;
+	case OP_SUBTRACT:	/* subtraction operator node */
+	    op = DB_OP_SUBTRACT;
+	    goto binary;
+	case OP_XOR:		/* exclusive "or" operator node */
+	    op = op_xor;
+	binary:				/* common for all binary nodes */
+	    /* both sides go straight into str, no temporaries */
+	    bu_vls_putc(str, '(');
+	    describe_tree(tree->tr_b.tb_left, str);
+	    bu_vls_printf(str, " %c ", op);
+	    describe_tree(tree->tr_b.tb_right, str);
+	    bu_vls_putc(str, ')');
+	    break;
+	case OP_NOT:
+	    bu_vls_strcat(str, "(!");
+	    describe_tree(tree->tr_b.tb_left, str);
+	    bu_vls_putc(str, ')');
+	    break;
+	case OP_GUARD:
+	    bu_vls_strcat(str, "(G");
+	    describe_tree(tree->tr_b.tb_left, str);
+	    bu_vls_putc(str, ')');
+	    break;
+	case OP_XNOP:
+	    bu_vls_strcat(str, "(X");
+	    describe_tree(tree->tr_b.tb_left, str);
+	    bu_vls_putc(str, ')');
+	    break;
+	case OP_NOP:
+	    bu_vls_strcat(str, "NOP");
+	    break;
+	default:
+	    bu_exit(1, "ERROR: describe_tree() got unrecognized op (%d)\n", tree->tr_op);
+    }
+}
+
+
+
+/**
+ * @brief This routine is called when a region is first encountered in the
+ * hierarchy when processing a tree
+ *
+ *
+ *      @param tsp tree state (for parsing the tree)
+ *      @param pathp A listing of all the nodes traversed to get to this node in the database
+ *      @param combp the combination record for this region
+ */
+int
+region_start(struct db_tree_state *tsp,
+	     const struct db_full_path *pathp,
+	     const struct rt_comb_internal *combp,
+	     void *client_data)
+{
+    char *name;
+    struct directory *dp;
+    static struct bu_vls str = BU_VLS_INIT_ZERO;	/* reused, only grows */
+    struct user_data *your_stuff = (struct user_data *)client_data;
+    struct pov_frame frame;
+    int outer_phase = alloc_phase;
+
+    RT_CK_DBTS(tsp);
+    pov_capture_region(tsp, pathp, combp);
+    alloc_phase = POV_ALLOC_REGION;
+    pov_stats_begin(&frame);
+
+    /* the previous region's scratch and messages are done with */
+    pov_scratch_reset();
+    pov_log_flush();
+
+    /* the path is only spelled out when something will read it */
+    if (POV_LOGGING(POV_LOG_INFO) || trace_file || allocs_enabled) {
+	name = pov_scratch_path(pathp);
+	pov_log(POV_LOG_INFO, "region_start %s\n", name);
+	pov_trace_region(name);
+	pov_alloc_region(name);
+    }
+
+    if (POV_LOGGING(POV_LOG_DEBUG)) {
+	/* rt_pr_tol() logs for itself */
+	pov_log_flush();
+	bu_log("data = %ld\n", your_stuff->data);
+	rt_pr_tol(&your_stuff->tol);
+    }
+
+    dp = DB_FULL_PATH_CUR_DIR(pathp);
+
+    /* clines of the previous region go out as one batch */
+    pov_cline_flush();
+
+    /* the tree goes into the scene as a comment */
+    bu_vls_trunc(&str, 0);
+    describe_tree(combp->tree, &str);
+    pov_printf("// %s %s: %s\n", combp->region_flag ? "region" : "combination", dp->d_namep, bu_vls_addr(&str));
+
+    pov_stats_end(&frame, POV_STAT_REGION);
+    alloc_phase = outer_phase;
+    return 0;
+}
+
+
+/**
+ * @brief This is called when all sub-elements of a region have been processed by leaf_func.
+ *
+ *      @param tsp
+ *      @param pathp
+ *      @param curtree
+ *
+ *      @return TREE_NULL if data in curtree was "stolen", otherwise db_walk_tree will
+ *      clean up the data in the union tree * that is returned
+ *
+ * If it wants to retain the data in curtree it can by returning TREE_NULL.  Otherwise
+ * db_walk_tree will clean up the data in the union tree * that is returned.
+ *
+ */
+union tree *
+region_end (struct db_tree_state *tsp,
+	    const struct db_full_path *pathp,
+	    union tree *curtree,
+	    void *UNUSED(client_data))
+{
+    RT_CK_DBTS(tsp);
+
+    /* db_walk_tree() runs these once the whole walk is done, so no
+     * region's scratch is live any more */
+    pov_scratch_reset();
+
+    if (POV_LOGGING(POV_LOG_INFO))
+	pov_log(POV_LOG_INFO, "region_end   %s\n", pov_scratch_path(pathp));
+
+    return curtree;
+}
+
+/*declare torusflag*/
+int flag = 0 ;
+double Vadd[3];
+double maga;
+double magb;
+double magc;
+double magd;
+
+/* name of the -o output file, NULL when writing to stdout */
+static char *out_file = NULL;
+
+/* sidecar data files written so far, one per primitive */
+struct pov_sidecar {
+    const struct directory *dp;	/* unique even across submodel databases */
+    struct bu_vls path;
+};
+static struct bu_ptbl sidecars = BU_PTBL_INIT_ZERO;	/* struct pov_sidecar */
+
+
+/* declared POV-Ray materials, one per distinct region color and shader */
+struct pov_mater {
+    struct pov_mater *next;	/* hash chain */
+    struct bu_vls body;
+    int id;
+};
+#define POV_MATER_HASH 256
+static struct pov_mater *maters[POV_MATER_HASH];
+static int mater_count = 0;
+
+/* material of the primitive being written, set by primitive_func() */
+static char pov_mat[32] = "Material_0";
+
+
+/**
+ * @brief Print the POV-Ray material for a region color and shader.
+ *
+ * librt's plastic, mirror and glass are one Phong shader with
+ * different defaults, so all three map onto the same finish; their
+ * shine is POV-Ray's phong_size.  Unknown shaders get the plastic
+ * defaults and the "light" shader glows.
+ */
+static void
+pov_mater_body(struct bu_vls *vp, const float rgb[3], const char *shader)
+{
+    double sh = 10.0, sp = 0.7, di = 0.3, tr = 0.0, re = 0.0, ri = 1.0;
+    char buf[256];
+    char *word, *value;
+    size_t len = 0;
+
+    if (shader) {
+	while (isspace((unsigned char)*shader))
+	    shader++;
+	while (shader[len] && !isspace((unsigned char)shader[len]) && shader[len] != '{')
+	    len++;
+    }
+
+    if (len == 5 && !bu_strncmp(shader, "light", 5)) {
+	bu_vls_printf(vp, "texture { pigment { rgb <%g, %g, %g> } finish { ambient 1 diffuse 0 } }",
+		      rgb[0], rgb[1], rgb[2]);
+	return;
+    }
+    if (len == 6 && !bu_strncmp(shader, "mirror", 6)) {
+	sh = 4.0; sp = 0.6; di = 0.4; re = 0.75;
+    } else if (len == 5 && !bu_strncmp(shader, "glass", 5)) {
+	sh = 4.0; sp = 0.7; di = 0.3; tr = 0.8; re = 0.1; ri = 1.65;
+    }
+
+    /* "name {key value ...}" or the older "name key=value ..." */
+    if (shader && shader[len]) {
+	bu_strlcpy(buf, shader + len, sizeof(buf));
+	for (word = buf; *word; word++)
+	    if (*word == '{' || *word == '}' || *word == '=')
+		*word = ' ';
+	word = strtok(buf, " \t\n");
+	while (word && (value = strtok(NULL, " \t\n")) != NULL) {
+	    if (BU_STR_EQUAL(word, "sh") || BU_STR_EQUAL(word, "shine"))
+		sh = atof(value);
+	    else if (BU_STR_EQUAL(word, "sp") || BU_STR_EQUAL(word, "specular"))
+		sp = atof(value);
+	    else if (BU_STR_EQUAL(word, "di") || BU_STR_EQUAL(word, "diffuse"))
+		di = atof(value);
+	    else if (BU_STR_EQUAL(word, "tr") || BU_STR_EQUAL(word, "transmit"))
+		tr = atof(value);
+	    else if (BU_STR_EQUAL(word, "re") || BU_STR_EQUAL(word, "reflect"))
+		re = atof(value);
+	    else if (BU_STR_EQUAL(word, "ri"))
+		ri = atof(value);
+	    word = strtok(NULL, " \t\n");
+	}
+    }
+
+    bu_vls_printf(vp, "texture { pigment { rgbf <%g, %g, %g, %g> }", rgb[0], rgb[1], rgb[2], tr);
+    bu_vls_printf(vp, " finish { diffuse %g phong %g phong_size %g", di, sp, sh);
+    if (re > 0.0)
+	bu_vls_printf(vp, " reflection %g", re);
+    bu_vls_printf(vp, " } }");
+    if (tr > 0.0 && !NEAR_EQUAL(ri, 1.0, SMALL_FASTF))
+	bu_vls_printf(vp, " interior { ior %g }", ri);
+}
+
+
+/**
+ * @brief Select the material for a region, declaring it on first use.
+ *
+ * Regions sharing a color and shader share one declared material,
+ * which POV-Ray then keeps once in memory.  Regions without a color
+ * are LightBlue, as g-pov has always drawn them.
+ */
+static void
+pov_material(const struct mater_info *mp)
+{
+    static const float lightblue[3] = {0.74902, 0.847059, 0.847059};
+    struct bu_vls body = BU_VLS_INIT_ZERO;
+    struct pov_mater *tp;
+    const char *cp;
+    unsigned long hash = 5381;
+
+    pov_mater_body(&body, mp->ma_color_valid ? mp->ma_color : lightblue, mp->ma_shader);
+
+    for (cp = bu_vls_addr(&body); *cp; cp++)
+	hash = hash * 33 + (unsigned char)*cp;
+    hash %= POV_MATER_HASH;
+
+    for (tp = maters[hash]; tp; tp = tp->next)
+	if (BU_STR_EQUAL(bu_vls_addr(&tp->body), bu_vls_addr(&body)))
+	    break;
+
+    if (tp) {
+	bu_vls_free(&body);
+    } else {
+	BU_ALLOC(tp, struct pov_mater);
+	tp->body = body;
+	tp->id = mater_count++;
+	tp->next = maters[hash];
+	maters[hash] = tp;
+	pov_printf("#declare Material_%d = material { %s }\n", tp->id, bu_vls_addr(&tp->body));
+    }
+
+    snprintf(pov_mat, sizeof(pov_mat), "Material_%d", tp->id);
+}
+
+
+/* release the material table */
+static void
+pov_material_free(void)
+{
+    struct pov_mater *tp;
+    int i;
+
+    for (i = 0; i < POV_MATER_HASH; i++) {
+	while ((tp = maters[i]) != NULL) {
+	    maters[i] = tp->next;
+	    bu_vls_free(&tp->body);
+	    bu_free(tp, "pov_mater");
+	}
+    }
+}
+
+
+/**
+ * @brief Print a BRL-CAD matrix as a POV-Ray "matrix" modifier.
+ *
+ * BRL-CAD matrices transform column vectors, POV-Ray transforms row
+ * vectors, so the upper 4x3 is written transposed.
+ */
+static void
+pov_matrix(const mat_t m)
+{
+    pov_printf("\tmatrix <%g, %g, %g,  %g, %g, %g,  %g, %g, %g,  %g, %g, %g>\n",
+	   m[0], m[4], m[8],
+	   m[1], m[5], m[9],
+	   m[2], m[6], m[10],
+	   m[3], m[7], m[11]);
+}
+
+
+/**
+ * @brief Build the matrix taking a primitive's unit space into model
+ * space: the unit X, Y and Z axes map to e0, e1 and e2 and the unit
+ * origin maps to "origin".
+ */
+static void
+pov_unit_frame(mat_t m, const point_t origin, const vect_t e0, const vect_t e1, const vect_t e2)
+{
+    MAT_IDN(m);
+    m[0] = e0[X];
+    m[4] = e0[Y];
+    m[8] = e0[Z];
+    m[1] = e1[X];
+    m[5] = e1[Y];
+    m[9] = e1[Z];
+    m[2] = e2[X];
+    m[6] = e2[Y];
+    m[10] = e2[Z];
+    MAT_DELTAS_VEC(m, origin);
+}
+
+
+/**
+ * @brief Build the path of a data file written next to the POV output.
+ *
+ * Sidecar files take the output file name (less its extension) as a
+ * prefix, or are written to the current directory when the output is
+ * stdout.  The primitive name gets the same substitutions used for
+ * region file names: "/" becomes "@", "." and white space become "_".
+ * A name already taken by another primitive, the same name from
+ * another submodel database, gets a number appended.
+ *
+ * The offset of the file name within the path, past any directory in
+ * the -o name, is put in *base; the scene refers to the file by that
+ * name alone, so POV-Ray has to be run from the output directory.
+ * Returns 1 when the file is yet to be written, 0 when it was written
+ * for an earlier instance of the primitive.
+ */
+static int
+pov_sidecar_name(struct bu_vls *vp, size_t *base, const struct directory *dp, const char *ext)
+{
+    struct pov_sidecar *scp;
+    const char *cp;
+    size_t i, stem;
+    int n;
+
+    bu_vls_trunc(vp, 0);
+    *base = 0;
+    if (out_file && (cp = strrchr(out_file, '/')) != NULL)
+	*base = cp + 1 - out_file;
+
+    for (i = 0; i < BU_PTBL_LEN(&sidecars); i++) {
+	scp = (struct pov_sidecar *)BU_PTBL_GET(&sidecars, i);
+	if (scp->dp == dp) {
+	    bu_vls_vlscat(vp, &scp->path);
+	    return 0;
+	}
+    }
+
+    if (out_file) {
+	const char *dot = strrchr(out_file, '.');
+
+	if (dot && dot - out_file >= (ptrdiff_t)*base)
+	    bu_vls_strncat(vp, out_file, dot - out_file);
+	else
+	    bu_vls_strcat(vp, out_file);
+	bu_vls_putc(vp, '_');
+    }
+
+    for (cp = dp->d_namep; *cp; cp++) {
+	if (*cp == '/')
+	    bu_vls_putc(vp, '@');
+	else if (*cp == '.' || isspace((int)*cp))
+	    bu_vls_putc(vp, '_');
+	else
+	    bu_vls_putc(vp, *cp);
+    }
+    stem = bu_vls_strlen(vp);
+    bu_vls_strcat(vp, ext);
+
+    for (n = 2, i = 0; i < BU_PTBL_LEN(&sidecars); i++) {
+	scp = (struct pov_sidecar *)BU_PTBL_GET(&sidecars, i);
+	if (BU_STR_EQUAL(bu_vls_addr(&scp->path), bu_vls_addr(vp))) {
+	    bu_vls_trunc(vp, stem);
+	    bu_vls_printf(vp, "_%d%s", n++, ext);
+	    i = (size_t)-1;	/* and check the new name from the start */
+	}
+    }
+
+    BU_ALLOC(scp, struct pov_sidecar);
+    scp->dp = dp;
+    bu_vls_init(&scp->path);
+    bu_vls_vlscat(&scp->path, vp);
+    bu_ptbl_ins(&sidecars, (long *)scp);
+    return 1;
+}
+
+
+/**
+ * @brief Write a 16-bit binary PGM for use as a POV-Ray height_field.
+ *
+ * Samples are indexed [row * width + col] with row 0 at the low edge
+ * of the terrain.  POV-Ray places the first image row at z=1, so rows
+ * are written from the top down.  Returns 0 on success.
+ */
+static int
+pov_write_pgm16(const char *path, const unsigned short *samples, size_t width, size_t height)
+{
+    FILE *fp;
+    unsigned char *line;
+    size_t row, col;
+    int ret = 0;
+
+    fp = fopen(path, "wb");
+    if (!fp) {
+	pov_log(POV_LOG_WARN, "g-pov: unable to create height field image %s\n", path);
+	return -1;
+    }
+
+    fprintf(fp, "P5\n%lu %lu\n65535\n", (unsigned long)width, (unsigned long)height);
+
+    /* PGM stores 16-bit samples most significant byte first */
+    line = (unsigned char *)bu_malloc(width * 2, "pgm scanline");
+    for (row = height; row-- > 0;) {
+	const unsigned short *sp = &samples[row * width];
+	for (col = 0; col < width; col++) {
+	    line[col*2] = (sp[col] >> 8) & 0xff;
+	    line[col*2+1] = sp[col] & 0xff;
+	}
+	if (fwrite(line, 2, width, fp) != width) {
+	    pov_log(POV_LOG_WARN, "g-pov: error writing height field image %s\n", path);
+	    ret = -1;
+	    break;
+	}
+    }
+    bu_free(line, "pgm scanline");
+
+    if (fclose(fp) != 0)
+	ret = -1;
+
+    return ret;
+}
+
+
+/**
+ * @brief Emit a POV-Ray height_field for a terrain whose samples have
+ * already been written to "path".
+ *
+ * "hf2model" maps the unit height_field (x and z across the grid, y
+ * up) into model space.
+ */
+static void
+pov_height_field(const char *path, int smooth, const mat_t hf2model)
+{
+    pov_printf("height_field {\n");
+    pov_printf("\tpgm \"%s\"\n", path);
+    if (smooth)
+	pov_printf("\tsmooth\n");
+    pov_matrix(hf2model);
+    pov_printf("\tmaterial { %s }\n}\n", pov_mat);
+}
+
+
+/**
+ * @brief Convert a displacement map to a height_field.
+ *
+ * The elevation data (a file or binunif object) is already loaded into
+ * dsp_buf as unsigned shorts, which is exactly what a 16-bit PGM holds.
+ */
+static void
+pov_dsp(struct directory *dp, const struct rt_dsp_internal *dsp)
+{
+    struct bu_vls path = BU_VLS_INIT_ZERO;
+    size_t base;
+    mat_t hf2dsp;
+    mat_t hf2model;
+
+    if (!dsp->dsp_buf || dsp->dsp_xcnt < 2 || dsp->dsp_ycnt < 2) {
+	pov_log(POV_LOG_WARN, "g-pov: DSP %s has no elevation data, skipped\n", dp->d_namep);
+	return;
+    }
+
+    if (pov_sidecar_name(&path, &base, dp, ".pgm")) {
+	if (pov_write_pgm16(bu_vls_addr(&path), dsp->dsp_buf, dsp->dsp_xcnt, dsp->dsp_ycnt)) {
+	    bu_vls_free(&path);
+	    return;
+	}
+    }
+
+    /* unit height_field (x, height, z) to DSP solid coordinates
+     * (column, row, elevation)
+     */
+    MAT_ZERO(hf2dsp);
+    hf2dsp[0] = dsp->dsp_xcnt - 1;
+    hf2dsp[6] = dsp->dsp_ycnt - 1;
+    hf2dsp[9] = 65535.0;
+    hf2dsp[15] = 1.0;
+    bn_mat_mul(hf2model, dsp->dsp_stom, hf2dsp);
+
+    pov_height_field(bu_vls_addr(&path) + base, dsp->dsp_smooth, hf2model);
+    bu_vls_free(&path);
+}
+
+
+/**
+ * @brief Convert a height field to a height_field.
+ *
+ * HF data is either unsigned shorts, which are used as is, or doubles
+ * which are rescaled to fill the 16-bit range of the image.
+ */
+static void
+pov_hf(struct directory *dp, const struct rt_hf_internal *hf)
+{
+    struct bu_vls path = BU_VLS_INIT_ZERO;
+    size_t base;
+    size_t count = (size_t)hf->w * (size_t)hf->n;
+    fastf_t zmin = 0.0;
+    fastf_t zrange = 65535.0;
+    vect_t xbasis, ybasis, zbasis;
+    point_t origin;
+    mat_t hf2model;
+    size_t i;
+
+    if (!hf->mp || !hf->mp->apbuf || hf->w < 2 || hf->n < 2) {
+	pov_log(POV_LOG_WARN, "g-pov: HF %s has no elevation data, skipped\n", dp->d_namep);
+	return;
+    }
+
+    if (!hf->shorts) {
+	const double *fp = (const double *)hf->mp->apbuf;
+
+	zmin = zrange = fp[0];
+	for (i = 1; i < count; i++) {
+	    if (fp[i] < zmin)
+		zmin = fp[i];
+	    if (fp[i] > zrange)
+		zrange = fp[i];
+	}
+	zrange -= zmin;
+	if (ZERO(zrange))
+	    zrange = 1.0;
+    }
+
+    if (pov_sidecar_name(&path, &base, dp, ".pgm")) {
+	int ret;
+
+	if (hf->shorts) {
+	    ret = pov_write_pgm16(bu_vls_addr(&path), (const unsigned short *)hf->mp->apbuf, hf->w, hf->n);
+	} else {
+	    const double *fp = (const double *)hf->mp->apbuf;
+	    unsigned short *samples;
+
+	    samples = (unsigned short *)bu_malloc(count * sizeof(unsigned short), "hf samples");
+	    for (i = 0; i < count; i++)
+		samples[i] = (unsigned short)((fp[i] - zmin) / zrange * 65535.0 + 0.5);
+	    ret = pov_write_pgm16(bu_vls_addr(&path), samples, hf->w, hf->n);
+	    bu_free(samples, "hf samples");
+	}
+	if (ret) {
+	    bu_vls_free(&path);
+	    return;
+	}
+    }
+
+    /* the HF is laid out along "x" and "y" with elevation along their
+     * cross product, all elevations in file units
+     */
+    VMOVE(xbasis, hf->x);
+    VUNITIZE(xbasis);
+    VMOVE(ybasis, hf->y);
+    VUNITIZE(ybasis);
+    VCROSS(zbasis, xbasis, ybasis);
+    VSCALE(zbasis, zbasis, hf->file2mm * hf->zscale);
+    VJOIN1(origin, hf->v, zmin, zbasis);
+
+    VSCALE(xbasis, xbasis, hf->xlen);
+    VSCALE(ybasis, ybasis, hf->ylen);
+    VSCALE(zbasis, zbasis, zrange);
+    pov_unit_frame(hf2model, origin, xbasis, zbasis, ybasis);
+
+    pov_height_field(bu_vls_addr(&path) + base, 0, hf2model);
+    bu_vls_free(&path);
+}
+
+
+/**
+ * @brief Shared job counter for emitters that split their work across
+ * bu_parallel() workers.
+ */
+struct pov_work {
+    size_t next;	/* next job to hand out */
+    size_t njobs;
+    void *data;		/* emitter specific state */
+};
+
+
+/**
+ * @brief Claim the next job, returning njobs when there are none left.
+ */
+static size_t
+pov_work_next(struct pov_work *wp)
+{
+    size_t job;
+
+    bu_semaphore_acquire(BU_SEM_GENERAL);
+    job = wp->next;
+    if (job < wp->njobs)
+	wp->next++;
+    bu_semaphore_release(BU_SEM_GENERAL);
+
+    return job;
+}
+
+
+/**
+ * @brief Open addressed hash table mapping 64-bit keys (packed lattice
+ * coordinates, pointers, ...) to mesh vertex indices.
+ */
+struct pov_vhash {
+    size_t size;	/* number of slots, always a power of two */
+    size_t count;	/* slots in use */
+    uint64_t *keys;
+    long *vals;		/* -1 marks an empty slot */
+};
+
+
+static void
+pov_vhash_init(struct pov_vhash *hp, size_t hint)
+{
+    size_t i;
+
+    hp->size = 64;
+    while (hp->size < hint * 2)
+	hp->size <<= 1;
+    hp->count = 0;
+    hp->keys = (uint64_t *)bu_malloc(hp->size * sizeof(uint64_t), "vhash keys");
+    hp->vals = (long *)bu_malloc(hp->size * sizeof(long), "vhash vals");
+    for (i = 0; i < hp->size; i++)
+	hp->vals[i] = -1;
+}
+
+
+static void
+pov_vhash_free(struct pov_vhash *hp)
+{
+    bu_free(hp->keys, "vhash keys");
+    bu_free(hp->vals, "vhash vals");
+    hp->keys = NULL;
+    hp->vals = NULL;
+    hp->size = hp->count = 0;
+}
+
+
+static size_t
+pov_vhash_slot(const struct pov_vhash *hp, uint64_t key)
+{
+    /* 64-bit finalizer from MurmurHash3 */
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+
+    return (size_t)key & (hp->size - 1);
+}
+
+
+/**
+ * @brief Return the value stored for "key", inserting "val" first if
+ * the key is not yet present.
+ */
+static long
+pov_vhash_lookup(struct pov_vhash *hp, uint64_t key, long val)
+{
+    size_t i;
+
+    if ((hp->count + 1) * 2 > hp->size) {
+	struct pov_vhash bigger;
+
+	pov_vhash_init(&bigger, hp->size);
+	for (i = 0; i < hp->size; i++) {
+	    if (hp->vals[i] >= 0)
+		(void)pov_vhash_lookup(&bigger, hp->keys[i], hp->vals[i]);
+	}
+	pov_vhash_free(hp);
+	*hp = bigger;
+    }
+
+    for (i = pov_vhash_slot(hp, key); hp->vals[i] >= 0; i = (i + 1) & (hp->size - 1)) {
+	if (hp->keys[i] == key)
+	    return hp->vals[i];
+    }
+    hp->keys[i] = key;
+    hp->vals[i] = val;
+    hp->count++;
+
+    return val;
+}
+
+
+/**
+ * @brief Triangle mesh accumulated by the mesh emitters and written as
+ * a single shared vertex mesh2.
+ */
+struct pov_mesh {
+    size_t nverts;
+    size_t maxverts;
+    fastf_t *verts;
+    size_t nfaces;
+    size_t maxfaces;
+    int *faces;
+};
+#define POV_MESH_INIT_ZERO {0, 0, NULL, 0, 0, NULL}
+
+
+static size_t
+pov_mesh_vert(struct pov_mesh *mp, const point_t pt)
+{
+    if (mp->nverts >= mp->maxverts) {
+	mp->maxverts = mp->maxverts ? mp->maxverts * 2 : 1024;
+	mp->verts = (fastf_t *)bu_realloc(mp->verts, mp->maxverts * 3 * sizeof(fastf_t), "mesh verts");
+    }
+    VMOVE(&mp->verts[mp->nverts * 3], pt);
+
+    return mp->nverts++;
+}
+
+
+static void
+pov_mesh_tri(struct pov_mesh *mp, size_t a, size_t b, size_t c)
+{
+    int *fp;
+
+    if (a == b || b == c || c == a)
+	return;
+
+    if (mp->nfaces >= mp->maxfaces) {
+	mp->maxfaces = mp->maxfaces ? mp->maxfaces * 2 : 1024;
+	mp->faces = (int *)bu_realloc(mp->faces, mp->maxfaces * 3 * sizeof(int), "mesh faces");
+    }
+    fp = &mp->faces[mp->nfaces * 3];
+    fp[0] = (int)a;
+    fp[1] = (int)b;
+    fp[2] = (int)c;
+    mp->nfaces++;
+}
+
+
+static void
+pov_mesh_free(struct pov_mesh *mp)
+{
+    if (mp->verts)
+	bu_free(mp->verts, "mesh verts");
+    if (mp->faces)
+	bu_free(mp->faces, "mesh faces");
+    mp->verts = NULL;
+    mp->faces = NULL;
+    mp->nverts = mp->maxverts = mp->nfaces = mp->maxfaces = 0;
+}
+
+
+/**
+ * @brief Write a mesh as a POV-Ray mesh2.
+ *
+ * "xform" maps mesh coordinates into model space, and may be NULL
+ * when the vertices are already in model coordinates.  The
+ * inside_vector lets POV-Ray treat a closed mesh as a solid in CSG.
+ */
+static void
+pov_mesh_write(const struct pov_mesh *mp, const mat_t xform)
+{
+    size_t i;
+
+    if (mp->nfaces == 0)
+	return;
+
+    pov_printf("mesh2 {\n\tvertex_vectors {\n\t\t%lu", (unsigned long)mp->nverts);
+    for (i = 0; i < mp->nverts; i++)
+	pov_printf(",%s<%g, %g, %g>", (i % 4) ? " " : "\n\t\t", V3ARGS(&mp->verts[i * 3]));
+    pov_printf("\n\t}\n\tface_indices {\n\t\t%lu", (unsigned long)mp->nfaces);
+    for (i = 0; i < mp->nfaces; i++)
+	pov_printf(",%s<%d, %d, %d>", (i % 6) ? " " : "\n\t\t", V3ARGS(&mp->faces[i * 3]));
+    pov_printf("\n\t}\n\tinside_vector <0, 0, 1>\n");
+    if (xform)
+	pov_matrix(xform);
+    pov_printf("\tmaterial { %s }\n}\n", pov_mat);
+    pov_verts += mp->nverts;
+    pov_faces += mp->nfaces;
+}
+
+
+/**
+ * @brief Emit a solid bounded by a quadric surface and a box.
+ *
+ * The quadric is given in the primitive's unit space as POV-Ray's ten
+ * coefficients (x2, y2, z2, xy, xz, yz, x, y, z, constant), negative
+ * inside.  Intersecting it with the box [lo, hi] supplies the end caps
+ * as real faces, and the same box bounds the intersection tests.
+ */
+static void
+pov_quadric(const fastf_t q[10], const point_t lo, const point_t hi, const mat_t unit2model)
+{
+    pov_printf("intersection {\n");
+    pov_printf("\tquadric { <%g, %g, %g>, <%g, %g, %g>, <%g, %g, %g>, %g }\n",
+	   q[0], q[1], q[2], q[3], q[4], q[5], q[6], q[7], q[8], q[9]);
+    pov_printf("\tbox { <%g, %g, %g>, <%g, %g, %g> }\n", V3ARGS(lo), V3ARGS(hi));
+    pov_printf("\tbounded_by { box { <%g, %g, %g>, <%g, %g, %g> } }\n", V3ARGS(lo), V3ARGS(hi));
+    pov_matrix(unit2model);
+    pov_printf("\tmaterial { %s }\n}\n", pov_mat);
+}
+
+
+/**
+ * @brief Right parabolic cylinder.
+ *
+ * Unit space has the half width r along X, B along Y and H along Z,
+ * where the parabola is x^2 + y = 1 with its vertex at the tip of B.
+ */
+static void
+pov_rpc(struct directory *dp, const struct rt_rpc_internal *rpc)
+{
+    static const fastf_t q[10] = {1, 0, 0, 0, 0, 0, 0, 1, 0, -1};
+    point_t lo = {-1, 0, 0};
+    point_t hi = {1, 1, 1};
+    vect_t r;
+    mat_t m;
+
+    VCROSS(r, rpc->rpc_H, rpc->rpc_B);
+    if (ZERO(MAGNITUDE(r)) || rpc->rpc_r <= 0.0) {
+	pov_log(POV_LOG_WARN, "g-pov: RPC %s is degenerate, skipped\n", dp->d_namep);
+	return;
+    }
+    VUNITIZE(r);
+    VSCALE(r, r, rpc->rpc_r);
+
+    pov_unit_frame(m, rpc->rpc_V, r, rpc->rpc_B, rpc->rpc_H);
+    pov_quadric(q, lo, hi, m);
+}
+
+
+/**
+ * @brief Right hyperbolic cylinder.
+ *
+ * Same unit space as the RPC.  With b = |B| the hyperbola passes
+ * through (+-1, 0) and (0, 1), and its asymptotes cross a distance c
+ * beyond the vertex:
+ *
+ *	(b^2 + 2bc) x^2 - b^2 y^2 + 2b(b + c) y - (b^2 + 2bc) = 0
+ *
+ * which is divided through by b^2 + 2bc.  The second sheet lies beyond
+ * y = 1 and is cut away by the box.
+ */
+static void
+pov_rhc(struct directory *dp, const struct rt_rhc_internal *rhc)
+{
+    fastf_t q[10] = {1, 0, 0, 0, 0, 0, 0, 0, 0, -1};
+    point_t lo = {-1, 0, 0};
+    point_t hi = {1, 1, 1};
+    fastf_t b = MAGNITUDE(rhc->rhc_B);
+    fastf_t k = b * b + 2.0 * b * rhc->rhc_c;
+    vect_t r;
+    mat_t m;
+
+    VCROSS(r, rhc->rhc_H, rhc->rhc_B);
+    if (ZERO(MAGNITUDE(r)) || rhc->rhc_r <= 0.0 || ZERO(k)) {
+	pov_log(POV_LOG_WARN, "g-pov: RHC %s is degenerate, skipped\n", dp->d_namep);
+	return;
+    }
+    VUNITIZE(r);
+    VSCALE(r, r, rhc->rhc_r);
+
+    q[1] = -b * b / k;
+    q[7] = 2.0 * b * (b + rhc->rhc_c) / k;
+
+    pov_unit_frame(m, rhc->rhc_V, r, rhc->rhc_B, rhc->rhc_H);
+    pov_quadric(q, lo, hi, m);
+}
+
+
+/**
+ * @brief Elliptical paraboloid.
+ *
+ * Unit space has r1 along Au on X, r2 on Y and H along Z, so the base
+ * ellipse is the unit circle at z = 0 and the vertex is at z = 1:
+ *
+ *	x^2 + y^2 + z - 1 = 0
+ */
+static void
+pov_epa(struct directory *dp, const struct rt_epa_internal *epa)
+{
+    static const fastf_t q[10] = {1, 1, 0, 0, 0, 0, 0, 0, 1, -1};
+    point_t lo = {-1, -1, 0};
+    point_t hi = {1, 1, 1};
+    vect_t a, b;
+    mat_t m;
+
+    VCROSS(b, epa->epa_H, epa->epa_Au);
+    if (ZERO(MAGNITUDE(b)) || epa->epa_r1 <= 0.0 || epa->epa_r2 <= 0.0) {
+	pov_log(POV_LOG_WARN, "g-pov: EPA %s is degenerate, skipped\n", dp->d_namep);
+	return;
+    }
+    VUNITIZE(b);
+    VSCALE(b, b, epa->epa_r2);
+    VMOVE(a, epa->epa_Au);
+    VUNITIZE(a);
+    VSCALE(a, a, epa->epa_r1);
+
+    pov_unit_frame(m, epa->epa_V, a, b, epa->epa_H);
+    pov_quadric(q, lo, hi, m);
+}
+
+
+/**
+ * @brief Elliptical hyperboloid.
+ *
+ * Same unit space as the EPA.  With h = |H| and c the distance from the
+ * vertex to where the asymptotic cone meets the axis:
+ *
+ *	(h^2 + 2hc)(x^2 + y^2) - h^2 z^2 + 2h(h + c) z - (h^2 + 2hc) = 0
+ *
+ * divided through by h^2 + 2hc.  The box removes the second sheet.
+ */
+static void
+pov_ehy(struct directory *dp, const struct rt_ehy_internal *ehy)
+{
+    fastf_t q[10] = {1, 1, 0, 0, 0, 0, 0, 0, 0, -1};
+    point_t lo = {-1, -1, 0};
+    point_t hi = {1, 1, 1};
+    fastf_t h = MAGNITUDE(ehy->ehy_H);
+    fastf_t k = h * h + 2.0 * h * ehy->ehy_c;
+    vect_t a, b;
+    mat_t m;
+
+    VCROSS(b, ehy->ehy_H, ehy->ehy_Au);
+    if (ZERO(MAGNITUDE(b)) || ehy->ehy_r1 <= 0.0 || ehy->ehy_r2 <= 0.0 || ZERO(k)) {
+	pov_log(POV_LOG_WARN, "g-pov: EHY %s is degenerate, skipped\n", dp->d_namep);
+	return;
+    }
+    VUNITIZE(b);
+    VSCALE(b, b, ehy->ehy_r2);
+    VMOVE(a, ehy->ehy_Au);
+    VUNITIZE(a);
+    VSCALE(a, a, ehy->ehy_r1);
+
+    q[2] = -h * h / k;
+    q[8] = 2.0 * h * (h + ehy->ehy_c) / k;
+
+    pov_unit_frame(m, ehy->ehy_V, a, b, ehy->ehy_H);
+    pov_quadric(q, lo, hi, m);
+}
+
+
+/**
+ * @brief Hyperboloid of one sheet.
+ *
+ * Unit space is centered halfway up H with A on X, b on Y and H/2 on
+ * Z, so both end ellipses are unit circles and the neck has radius
+ * bnr:
+ *
+ *	x^2 + y^2 - (1 - bnr^2) z^2 - bnr^2 = 0
+ */
+static void
+pov_hyp(struct directory *dp, const struct rt_hyp_internal *hyp)
+{
+    fastf_t q[10] = {1, 1, 0, 0, 0, 0, 0, 0, 0, 0};
+    point_t lo = {-1, -1, -1};
+    point_t hi = {1, 1, 1};
+    point_t center;
+    vect_t b, half;
+    mat_t m;
+
+    VCROSS(b, hyp->hyp_Hi, hyp->hyp_A);
+    if (ZERO(MAGNITUDE(b)) || hyp->hyp_b <= 0.0 || hyp->hyp_bnr <= 0.0) {
+	pov_log(POV_LOG_WARN, "g-pov: HYP %s is degenerate, skipped\n", dp->d_namep);
+	return;
+    }
+    VUNITIZE(b);
+    VSCALE(b, b, hyp->hyp_b);
+    VSCALE(half, hyp->hyp_Hi, 0.5);
+    VADD2(center, hyp->hyp_Vi, half);
+
+    q[2] = -(1.0 - hyp->hyp_bnr * hyp->hyp_bnr);
+    q[9] = -hyp->hyp_bnr * hyp->hyp_bnr;
+
+    pov_unit_frame(m, center, hyp->hyp_A, b, half);
+    pov_quadric(q, lo, hi, m);
+}
+
+
+/* highest order of the polynomial surfaces written as "poly" */
+#define POV_POLY_MAX 6
+
+/**
+ * @brief Dense polynomial in x, y and z; c[i][j][k] is the coefficient
+ * of x^i y^j z^k.
+ */
+struct pov_poly {
+    fastf_t c[POV_POLY_MAX+1][POV_POLY_MAX+1][POV_POLY_MAX+1];
+};
+
+
+static void
+pov_poly_zero(struct pov_poly *pp)
+{
+    memset(pp, 0, sizeof(struct pov_poly));
+}
+
+
+/**
+ * @brief out = a * b, dropping any terms above POV_POLY_MAX.  "out" may
+ * not be one of the inputs.
+ */
+static void
+pov_poly_mul(struct pov_poly *out, const struct pov_poly *a, const struct pov_poly *b)
+{
+    int i, j, k, l, m, n;
+
+    pov_poly_zero(out);
+    for (i = 0; i <= POV_POLY_MAX; i++)
+	for (j = 0; i + j <= POV_POLY_MAX; j++)
+	    for (k = 0; i + j + k <= POV_POLY_MAX; k++) {
+		if (ZERO(a->c[i][j][k]))
+		    continue;
+		for (l = 0; i + j + k + l <= POV_POLY_MAX; l++)
+		    for (m = 0; i + j + k + l + m <= POV_POLY_MAX; m++)
+			for (n = 0; i + j + k + l + m + n <= POV_POLY_MAX; n++)
+			    out->c[i+l][j+m][k+n] += a->c[i][j][k] * b->c[l][m][n];
+	    }
+}
+
+
+/**
+ * @brief out = a + s * b
+ */
+static void
+pov_poly_add(struct pov_poly *out, const struct pov_poly *a, fastf_t s, const struct pov_poly *b)
+{
+    int i, j, k;
+
+    for (i = 0; i <= POV_POLY_MAX; i++)
+	for (j = 0; i + j <= POV_POLY_MAX; j++)
+	    for (k = 0; i + j + k <= POV_POLY_MAX; k++)
+		out->c[i][j][k] = a->c[i][j][k] + s * b->c[i][j][k];
+}
+
+
+/**
+ * @brief Emit an algebraic surface of the given order as a poly
+ * object, negative inside, bounded by the unit space box [lo, hi].
+ *
+ * POV-Ray orders the coefficients by descending powers of x, then y,
+ * then z, e.g. x^2, xy, xz, x, y^2, yz, y, z^2, z, 1 for order 2.
+ */
+static void
+pov_poly_write(const struct pov_poly *pp, int order, const point_t lo, const point_t hi, const mat_t unit2model)
+{
+    int i, j, k;
+    int count = 0;
+
+    pov_printf("poly {\n\t%d,\n\t<", order);
+    for (i = order; i >= 0; i--)
+	for (j = order - i; j >= 0; j--)
+	    for (k = order - i - j; k >= 0; k--)
+		pov_printf("%s%.15g", count++ ? ((count % 6 == 1) ? ",\n\t " : ", ") : "", pp->c[i][j][k]);
+    pov_printf(">\n\tsturm\n");
+    pov_printf("\tbounded_by { box { <%g, %g, %g>, <%g, %g, %g> } }\n", V3ARGS(lo), V3ARGS(hi));
+    pov_matrix(unit2model);
+    pov_printf("\tmaterial { %s }\n}\n", pov_mat);
+}
+
+
+/**
+ * @brief Elliptical torus as an exact quartic.
+ *
+ * In a unit space scaled so the torus fits in the unit sphere, with N
+ * along Z, the cross section ellipse has semi axes a (along C) and d
+ * (rd) tilted by phi from the radial direction and centered at radius
+ * r.  With rho = sqrt(x^2 + y^2) the ellipse is
+ *
+ *	alpha (rho - r)^2 + 2 beta (rho - r) z + gamma z^2 - 1 = 0
+ *
+ * Collecting the terms odd in rho as E + rho F = 0 and squaring away
+ * the root gives the quartic E^2 - (x^2 + y^2) F^2 = 0.
+ */
+static void
+pov_eto(struct directory *dp, const struct rt_eto_internal *eto)
+{
+    struct pov_poly rho2, e, f, tmp, q;
+    fastf_t a = MAGNITUDE(eto->eto_C);
+    fastf_t d = eto->eto_rd;
+    fastf_t r = eto->eto_r;
+    fastf_t cosphi, sinphi, cz;
+    fastf_t alpha, beta, gamma;
+    fastf_t rext, zext, scale;
+    point_t lo, hi;
+    vect_t n, u, v;
+    mat_t m;
+
+    VMOVE(n, eto->eto_N);
+    if (ZERO(MAGNITUDE(n)) || ZERO(a) || d <= 0.0 || r <= 0.0) {
+	pov_log(POV_LOG_WARN, "g-pov: ETO %s is degenerate, skipped\n", dp->d_namep);
+	return;
+    }
+    VUNITIZE(n);
+
+    /* tilt of C out of the plane of revolution */
+    cz = VDOT(eto->eto_C, n);
+    sinphi = cz / a;
+    cosphi = sqrt(FMAX(0.0, 1.0 - sinphi * sinphi));
+
+    /* radial and axial half extents of the cross section */
+    rext = sqrt(a * a * cosphi * cosphi + d * d * sinphi * sinphi);
+    zext = sqrt(a * a * sinphi * sinphi + d * d * cosphi * cosphi);
+    if (rext >= r)
+	pov_log(POV_LOG_WARN, "g-pov: ETO %s cross section reaches the axis\n", dp->d_namep);
+
+    scale = r + rext;
+    r /= scale;
+    a /= scale;
+    d /= scale;
+    rext /= scale;
+    zext /= scale;
+
+    alpha = cosphi * cosphi / (a * a) + sinphi * sinphi / (d * d);
+    beta = cosphi * sinphi * (1.0 / (a * a) - 1.0 / (d * d));
+    gamma = sinphi * sinphi / (a * a) + cosphi * cosphi / (d * d);
+
+    pov_poly_zero(&rho2);
+    rho2.c[2][0][0] = 1.0;
+    rho2.c[0][2][0] = 1.0;
+
+    pov_poly_zero(&e);
+    e.c[2][0][0] = alpha;
+    e.c[0][2][0] = alpha;
+    e.c[0][0][2] = gamma;
+    e.c[0][0][1] = -2.0 * beta * r;
+    e.c[0][0][0] = alpha * r * r - 1.0;
+
+    pov_poly_zero(&f);
+    f.c[0][0][1] = 2.0 * beta;
+    f.c[0][0][0] = -2.0 * alpha * r;
+
+    pov_poly_mul(&q, &e, &e);
+    pov_poly_mul(&tmp, &f, &f);
+    pov_poly_mul(&e, &tmp, &rho2);
+    pov_poly_add(&q, &q, -1.0, &e);
+
+    VSET(lo, -(r + rext), -(r + rext), -zext);
+    VSET(hi, r + rext, r + rext, zext);
+
+    bn_vec_ortho(u, n);
+    VCROSS(v, n, u);
+    VSCALE(u, u, scale);
+    VSCALE(v, v, scale);
+    VSCALE(n, n, scale);
+    pov_unit_frame(m, eto->eto_V, u, v, n);
+
+    pov_poly_write(&q, 4, lo, hi, m);
+}
+
+
+/**
+ * @brief Heart as its exact sextic.
+ *
+ * In the unit space spanned by xdir, ydir and zdir the heart is
+ *
+ *	(x^2 + 9/4 y^2 + z^2 - 1)^3 - x^2 z^3 - 9/80 y^2 z^3 = 0
+ *
+ * which lies within x +-1.14, y +-0.682 and -1 <= z <= 1.24.
+ */
+static void
+pov_hrt(struct directory *dp, const struct rt_hrt_internal *hrt)
+{
+    struct pov_poly t, t2, q, z3;
+    point_t lo = {-1.14, -0.682, -1.0};
+    point_t hi = {1.14, 0.682, 1.24};
+    mat_t m;
+
+    if (ZERO(MAGNITUDE(hrt->xdir)) || ZERO(MAGNITUDE(hrt->ydir)) || ZERO(MAGNITUDE(hrt->zdir))) {
+	pov_log(POV_LOG_WARN, "g-pov: HRT %s is degenerate, skipped\n", dp->d_namep);
+	return;
+    }
+
+    pov_poly_zero(&t);
+    t.c[2][0][0] = 1.0;
+    t.c[0][2][0] = 9.0 / 4.0;
+    t.c[0][0][2] = 1.0;
+    t.c[0][0][0] = -1.0;
+    pov_poly_mul(&t2, &t, &t);
+    pov_poly_mul(&q, &t2, &t);
+
+    pov_poly_zero(&z3);
+    z3.c[2][0][3] = 1.0;
+    z3.c[0][2][3] = 9.0 / 80.0;
+    pov_poly_add(&q, &q, -1.0, &z3);
+
+    pov_unit_frame(m, hrt->v, hrt->xdir, hrt->ydir, hrt->zdir);
+    pov_poly_write(&q, 6, lo, hi, m);
+}
+
+
+/* twice the signed area of the 2D triangle a, b, c */
+static fastf_t
+tess_area2(const fastf_t *a, const fastf_t *b, const fastf_t *c)
+{
+    return (b[X] - a[X]) * (c[Y] - a[Y]) - (b[Y] - a[Y]) * (c[X] - a[X]);
+}
+
+
+/* does segment p1-p2 properly cross segment q1-q2? */
+static int
+tess_crosses(const fastf_t *p1, const fastf_t *p2, const fastf_t *q1, const fastf_t *q2)
+{
+    fastf_t d1 = tess_area2(q1, q2, p1);
+    fastf_t d2 = tess_area2(q1, q2, p2);
+    fastf_t d3 = tess_area2(p1, p2, q1);
+    fastf_t d4 = tess_area2(p1, p2, q2);
+
+    return ((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0))
+	&& ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0));
+}
+
+
+/* does the direction from v to p point into the left hand cone a, v, b? */
+static int
+tess_in_cone(const fastf_t *a, const fastf_t *v, const fastf_t *b, const fastf_t *p)
+{
+    if (tess_area2(a, v, b) > 0)
+	return tess_area2(a, v, p) > 0 && tess_area2(v, b, p) > 0;
+    return tess_area2(a, v, p) > 0 || tess_area2(v, b, p) > 0;
+}
+
+
+/* can the bridge p1-p2 be drawn past edge q1-q2 without touching it? */
+static int
+tess_blocks(const fastf_t *p1, const fastf_t *p2, const fastf_t *q1, const fastf_t *q2)
+{
+    fastf_t len2, t;
+
+    if (tess_crosses(p1, p2, q1, q2))
+	return 1;
+
+    /* a vertex sitting on the open bridge segment also blocks it */
+    if ((q1[X] == p1[X] && q1[Y] == p1[Y]) || (q1[X] == p2[X] && q1[Y] == p2[Y]))
+	return 0;
+    if (!ZERO(tess_area2(p1, p2, q1)))
+	return 0;
+    t = (p2[X] - p1[X]) * (q1[X] - p1[X]) + (p2[Y] - p1[Y]) * (q1[Y] - p1[Y]);
+    len2 = (p2[X] - p1[X]) * (p2[X] - p1[X]) + (p2[Y] - p1[Y]) * (p2[Y] - p1[Y]);
+    return t > 0.0 && t < len2;
+}
+
+
+/* is point p in the counter-clockwise triangle a, b, c (edges included)? */
+static int
+tess_in_tri(const fastf_t *p, const fastf_t *a, const fastf_t *b, const fastf_t *c)
+{
+    return tess_area2(a, b, p) >= 0 && tess_area2(b, c, p) >= 0 && tess_area2(c, a, p) >= 0;
+}
+
+
+/* even-odd test of point p against a ring of 2D points */
+static int
+tess_in_ring(const fastf_t *p, const fastf_t *uv, const size_t *ring, size_t n)
+{
+    size_t i, j;
+    int in = 0;
+
+    for (i = 0, j = n - 1; i < n; j = i++) {
+	const fastf_t *a = &uv[ring[i] * 2];
+	const fastf_t *b = &uv[ring[j] * 2];
+
+	if ((a[Y] > p[Y]) != (b[Y] > p[Y])
+	    && p[X] < (b[X] - a[X]) * (p[Y] - a[Y]) / (b[Y] - a[Y]) + a[X])
+	    in = !in;
+    }
+
+    return in;
+}
+
+
+/**
+ * @brief Join a clockwise hole into a counter-clockwise ring.
+ *
+ * The hole's rightmost point is connected to the nearest ring point
+ * that it can see, and the ring is cut open along that bridge.
+ * "ring" must have room for nhole + 2 more entries.
+ */
+static void
+tess_bridge(const fastf_t *uv, size_t *ring, size_t *nring, const size_t *hole, size_t nhole)
+{
+    const fastf_t *m, *ma, *mb;
+    fastf_t best_d = MAX_FASTF;
+    size_t best = 0;
+    size_t hm = 0;
+    int found = 0;
+    size_t i, j, r;
+    size_t n = *nring;
+
+    for (i = 1; i < nhole; i++) {
+	if (uv[hole[i] * 2] > uv[hole[hm] * 2])
+	    hm = i;
+    }
+    m = &uv[hole[hm] * 2];
+    ma = &uv[hole[(hm + nhole - 1) % nhole] * 2];
+    mb = &uv[hole[(hm + 1) % nhole] * 2];
+
+    for (r = 0; r < n; r++) {
+	const fastf_t *v = &uv[ring[r] * 2];
+	fastf_t d = (v[X] - m[X]) * (v[X] - m[X]) + (v[Y] - m[Y]) * (v[Y] - m[Y]);
+	int ok;
+
+	if (d >= best_d)
+	    continue;
+
+	/* the bridge must leave both ends into the polygon's interior */
+	ok = tess_in_cone(&uv[ring[(r + n - 1) % n] * 2], v, &uv[ring[(r + 1) % n] * 2], m)
+	    && tess_in_cone(ma, m, mb, v);
+
+	for (j = 0; ok && j < n; j++)
+	    ok = !tess_blocks(m, v, &uv[ring[j] * 2], &uv[ring[(j + 1) % n] * 2]);
+	for (j = 0; ok && j < nhole; j++)
+	    ok = !tess_blocks(m, v, &uv[hole[j] * 2], &uv[hole[(j + 1) % nhole] * 2]);
+
+	if (ok) {
+	    best_d = d;
+	    best = r;
+	    found = 1;
+	}
+    }
+
+    /* numerically hopeless; join to the nearest point regardless */
+    if (!found) {
+	for (r = 0; r < n; r++) {
+	    const fastf_t *v = &uv[ring[r] * 2];
+	    fastf_t d = (v[X] - m[X]) * (v[X] - m[X]) + (v[Y] - m[Y]) * (v[Y] - m[Y]);
+
+	    if (d < best_d) {
+		best_d = d;
+		best = r;
+	    }
+	}
+    }
+
+    /* ring[0..best], hole from hm all the way around to hm, ring[best..] */
+    memmove(&ring[best + nhole + 3], &ring[best + 1], (n - best - 1) * sizeof(size_t));
+    for (i = 0; i <= nhole; i++)
+	ring[best + 1 + i] = hole[(hm + i) % nhole];
+    ring[best + nhole + 2] = ring[best];
+    *nring = n + nhole + 2;
+}
+
+
+/**
+ * @brief Ear clip a counter-clockwise ring, adding the triangles to
+ * the mesh.  "vidx" maps ring entries to mesh vertex indices.  The
+ * links are taken from ap.
+ */
+static void
+tess_clip(struct pov_mesh *mp, struct pov_arena *ap, const fastf_t *uv, const size_t *vidx, const size_t *ring, size_t n)
+{
+    size_t *prev, *next;
+    size_t count = n;
+    size_t guard = 0;
+    size_t i;
+
+    if (n < 3)
+	return;
+
+    prev = (size_t *)pov_arena_alloc(ap, n * 2 * sizeof(size_t));
+    next = prev + n;
+    for (i = 0; i < n; i++) {
+	prev[i] = (i + n - 1) % n;
+	next[i] = (i + 1) % n;
+    }
+
+    i = 0;
+    while (count > 3) {
+	size_t p = prev[i];
+	size_t nx = next[i];
+	const fastf_t *a = &uv[ring[p] * 2];
+	const fastf_t *b = &uv[ring[i] * 2];
+	const fastf_t *c = &uv[ring[nx] * 2];
+	fastf_t area = tess_area2(a, b, c);
+	int ear = (area >= 0);
+
+	if (ear && area > 0) {
+	    size_t k;
+
+	    /* no other point may lie within the ear; bridge vertices
+	     * appear twice, so skip copies of the ear's own corners
+	     */
+	    for (k = next[nx]; k != p; k = next[k]) {
+		if (ring[k] == ring[p] || ring[k] == ring[i] || ring[k] == ring[nx])
+		    continue;
+		if (tess_in_tri(&uv[ring[k] * 2], a, b, c)) {
+		    ear = 0;
+		    break;
+		}
+	    }
+	}
+
+	if (!ear && ++guard <= count) {
+	    i = nx;
+	    continue;
+	}
+
+	/* a collinear point is dropped without a triangle; when no ear
+	 * is found after a full pass the ring is degenerate, clip anyway
+	 */
+	if (area > 0 || !ear)
+	    pov_mesh_tri(mp, vidx[ring[p]], vidx[ring[i]], vidx[ring[nx]]);
+	next[p] = nx;
+	prev[nx] = p;
+	count--;
+	guard = 0;
+	i = p;
+    }
+    pov_mesh_tri(mp, vidx[ring[prev[i]]], vidx[ring[i]], vidx[ring[next[i]]]);
+}
+
+
+/**
+ * @brief Triangulate a planar face bounded by one or more loops.
+ *
+ * The loops are given as runs of mesh vertex indices in "loopv", with
+ * loopn[i] entries in loop i.  Loops running counter-clockwise about
+ * "normal" are outer boundaries, clockwise loops are holes and are
+ * joined to the outer loop that contains them.  A NULL normal is
+ * taken from the first loop.  Temporaries come from ap and are
+ * released, overflow blocks and all, before returning.  Thread safe as
+ * long as each thread has its own mesh and arena.
+ */
+static void
+pov_tess_face(struct pov_mesh *mp, struct pov_arena *ap, const size_t *loopv, const size_t *loopn, size_t nloops, const fastf_t *normal)
+{
+    struct pov_arena_mark mark;
+    fastf_t *uv;
+    fastf_t *area;
+    size_t *ring, *loopstart;
+    size_t nv = 0;
+    size_t i, j, k;
+    vect_t n;
+    int u, v;
+
+    for (i = 0; i < nloops; i++)
+	nv += loopn[i];
+    if (nv < 3)
+	return;
+
+    if (normal) {
+	VMOVE(n, normal);
+    } else {
+	/* Newell's method on the first loop */
+	VSETALL(n, 0.0);
+	for (i = 0; i < loopn[0]; i++) {
+	    const fastf_t *p = &mp->verts[loopv[i] * 3];
+	    const fastf_t *q = &mp->verts[loopv[(i + 1) % loopn[0]] * 3];
+
+	    n[X] += (p[Y] - q[Y]) * (p[Z] + q[Z]);
+	    n[Y] += (p[Z] - q[Z]) * (p[X] + q[X]);
+	    n[Z] += (p[X] - q[X]) * (p[Y] + q[Y]);
+	}
+    }
+
+    /* a lone triangle needs no work */
+    if (nloops == 1 && nv == 3) {
+	pov_mesh_tri(mp, loopv[0], loopv[1], loopv[2]);
+	return;
+    }
+
+    /* project onto the coordinate plane most nearly parallel to the
+     * face, keeping counter-clockwise loops counter-clockwise
+     */
+    k = (fabs(n[X]) > fabs(n[Y])) ? X : Y;
+    if (fabs(n[Z]) > fabs(n[k]))
+	k = Z;
+    u = (k + 1) % 3;
+    v = (k + 2) % 3;
+    if (n[k] < 0) {
+	int t = u;
+	u = v;
+	v = t;
+    }
+
+    pov_arena_mark(ap, &mark);
+    uv = (fastf_t *)pov_arena_alloc(ap, (nv * 2 + nloops) * sizeof(fastf_t));
+    area = uv + nv * 2;
+    ring = (size_t *)pov_arena_alloc(ap, (nv * 2 + nloops * 3) * sizeof(size_t));
+    loopstart = ring + nv + nloops * 2;
+    for (i = 0; i < nv; i++) {
+	uv[i * 2] = mp->verts[loopv[i] * 3 + u];
+	uv[i * 2 + 1] = mp->verts[loopv[i] * 3 + v];
+    }
+
+    for (i = 0, j = 0; i < nloops; j += loopn[i++]) {
+	loopstart[i] = j;
+	area[i] = 0.0;
+	for (k = 0; k < loopn[i]; k++) {
+	    const fastf_t *p = &uv[(j + k) * 2];
+	    const fastf_t *q = &uv[(j + (k + 1) % loopn[i]) * 2];
+	    area[i] += p[X] * q[Y] - q[X] * p[Y];
+	}
+    }
+
+    for (i = 0; i < nloops; i++) {
+	size_t nring = loopn[i];
+	size_t h;
+
+	if (area[i] <= 0.0 || nring < 3)
+	    continue;
+
+	for (k = 0; k < nring; k++)
+	    ring[k] = loopstart[i] + k;
+
+	/* holes inside this outer loop, largest first so that the
+	 * bridges of smaller holes can not cut across them
+	 */
+	for (;;) {
+	    size_t hi = nloops;
+	    size_t *hv;
+
+	    for (h = 0; h < nloops; h++) {
+		if (area[h] >= 0.0 || loopn[h] < 3)
+		    continue;
+		if (!tess_in_ring(&uv[loopstart[h] * 2], uv, ring, nring))
+		    continue;
+		if (hi == nloops || area[h] < area[hi])
+		    hi = h;
+	    }
+	    if (hi == nloops)
+		break;
+
+	    hv = (size_t *)pov_arena_alloc(ap, loopn[hi] * sizeof(size_t));
+	    for (k = 0; k < loopn[hi]; k++)
+		hv[k] = loopstart[hi] + k;
+	    tess_bridge(uv, ring, &nring, hv, loopn[hi]);
+
+	    /* mark the hole as used */
+	    area[hi] = 0.0;
+	}
+
+	tess_clip(mp, ap, uv, loopv, ring, nring);
+    }
+
+    pov_arena_release(ap, &mark);
+}
+
+
+/* per shell triangulation produced by an nmg worker */
+struct nmg_shell_mesh {
+    const struct shell *s;
+    struct pov_mesh mesh;
+    struct vertex **vp;		/* NMG vertex of each mesh vertex */
+    size_t maxvp;
+};
+
+
+static size_t
+nmg_mesh_vert(struct nmg_shell_mesh *sm, struct pov_vhash *hp, struct vertex *vp)
+{
+    long idx = pov_vhash_lookup(hp, (uint64_t)(uintptr_t)vp, (long)sm->mesh.nverts);
+
+    if (idx == (long)sm->mesh.nverts) {
+	pov_mesh_vert(&sm->mesh, vp->vg_p->coord);
+	if (sm->maxvp < sm->mesh.maxverts) {
+	    sm->maxvp = sm->mesh.maxverts;
+	    sm->vp = (struct vertex **)bu_realloc(sm->vp, sm->maxvp * sizeof(struct vertex *), "nmg mesh vp");
+	}
+	sm->vp[idx] = vp;
+    }
+
+    return (size_t)idx;
+}
+
+
+/**
+ * @brief bu_parallel() worker triangulating one NMG shell per job.
+ *
+ * Only reads the model, so shells can be processed concurrently.
+ */
+static void
+nmg_tess_shells(int cpu, void *arg)
+{
+    int64_t start = pov_trace_begin();
+    struct pov_work *wp = (struct pov_work *)arg;
+    struct nmg_shell_mesh *shells = (struct nmg_shell_mesh *)wp->data;
+    struct pov_arena *ap = &worker_scratch[cpu];
+    size_t job;
+
+    pov_arena_reset(ap);
+
+    while ((job = pov_work_next(wp)) < wp->njobs) {
+	struct nmg_shell_mesh *sm = &shells[job];
+	struct pov_vhash vhash;
+	struct faceuse *fu;
+
+	pov_vhash_init(&vhash, 256);
+	for (BU_LIST_FOR(fu, faceuse, &sm->s->fu_hd)) {
+	    struct pov_arena_mark mark;
+	    struct loopuse *lu;
+	    struct edgeuse *eu;
+	    size_t *loopv, *loopn;
+	    size_t nv = 0;
+	    size_t nl = 0;
+	    vect_t n;
+
+	    /* each face appears twice, once per side */
+	    if (fu->orientation != OT_SAME)
+		continue;
+
+	    /* size the face's loop buffers, which last only for the face */
+	    for (BU_LIST_FOR(lu, loopuse, &fu->lu_hd)) {
+		if (BU_LIST_FIRST_MAGIC(&lu->down_hd) != NMG_EDGEUSE_MAGIC)
+		    continue;
+		nl++;
+		for (BU_LIST_FOR(eu, edgeuse, &lu->down_hd))
+		    nv++;
+	    }
+	    pov_arena_mark(ap, &mark);
+	    loopv = (size_t *)pov_arena_alloc(ap, (nv + 1) * sizeof(size_t));
+	    loopn = (size_t *)pov_arena_alloc(ap, (nl + 1) * sizeof(size_t));
+
+	    nv = nl = 0;
+	    for (BU_LIST_FOR(lu, loopuse, &fu->lu_hd)) {
+		if (BU_LIST_FIRST_MAGIC(&lu->down_hd) != NMG_EDGEUSE_MAGIC)
+		    continue;
+		loopn[nl] = 0;
+		for (BU_LIST_FOR(eu, edgeuse, &lu->down_hd)) {
+		    loopv[nv++] = nmg_mesh_vert(sm, &vhash, eu->vu_p->v_p);
+		    loopn[nl]++;
+		}
+		nl++;
+	    }
+
+	    NMG_GET_FU_NORMAL(n, fu);
+	    pov_tess_face(&sm->mesh, ap, loopv, loopn, nl, n);
+	    pov_arena_release(ap, &mark);
+	}
+	pov_vhash_free(&vhash);
+    }
+
+    pov_trace_end("nmg shells", "tessellate", cpu + 1, start);
+}
+
+
+/**
+ * @brief Convert an NMG model straight to a shared vertex mesh2.
+ *
+ * Shells are triangulated in parallel, then merged serially so that
+ * vertices shared between shells are written only once.
+ */
+static void
+pov_nmg(struct directory *dp, const struct model *m, int ncpu)
+{
+    struct nmg_shell_mesh *shells;
+    struct pov_mesh mesh = POV_MESH_INIT_ZERO;
+    struct pov_vhash vhash;
+    struct pov_work work;
+    struct nmgregion *r;
+    struct shell *s;
+    size_t nshells = 0;
+    size_t i, j;
+
+    NMG_CK_MODEL(m);
+
+    for (BU_LIST_FOR(r, nmgregion, &m->r_hd))
+	for (BU_LIST_FOR(s, shell, &r->s_hd))
+	    nshells++;
+    if (nshells == 0) {
+	pov_log(POV_LOG_WARN, "g-pov: NMG %s has no shells, skipped\n", dp->d_namep);
+	return;
+    }
+
+    shells = (struct nmg_shell_mesh *)bu_calloc(nshells, sizeof(struct nmg_shell_mesh), "nmg shells");
+    nshells = 0;
+    for (BU_LIST_FOR(r, nmgregion, &m->r_hd))
+	for (BU_LIST_FOR(s, shell, &r->s_hd))
+	    shells[nshells++].s = s;
+
+    work.next = 0;
+    work.njobs = nshells;
+    work.data = shells;
+    bu_parallel(nmg_tess_shells, ncpu, &work);
+
+    pov_vhash_init(&vhash, 1024);
+    for (i = 0; i < nshells; i++) {
+	struct nmg_shell_mesh *sm = &shells[i];
+	size_t *map;
+
+	if (sm->mesh.nverts) {
+	    map = (size_t *)bu_malloc(sm->mesh.nverts * sizeof(size_t), "nmg vertex map");
+	    for (j = 0; j < sm->mesh.nverts; j++) {
+		long idx = pov_vhash_lookup(&vhash, (uint64_t)(uintptr_t)sm->vp[j], (long)mesh.nverts);
+
+		if (idx == (long)mesh.nverts)
+		    pov_mesh_vert(&mesh, &sm->mesh.verts[j * 3]);
+		map[j] = (size_t)idx;
+	    }
+	    for (j = 0; j < sm->mesh.nfaces; j++) {
+		const int *fp = &sm->mesh.faces[j * 3];
+		pov_mesh_tri(&mesh, map[fp[0]], map[fp[1]], map[fp[2]]);
+	    }
+	    bu_free(map, "nmg vertex map");
+	}
+	pov_mesh_free(&sm->mesh);
+	if (sm->vp)
+	    bu_free(sm->vp, "nmg mesh vp");
+    }
+    bu_free(shells, "nmg shells");
+    pov_vhash_free(&vhash);
+
+    if (mesh.nfaces == 0)
+	pov_log(POV_LOG_WARN, "g-pov: NMG %s has no faces, skipped\n", dp->d_namep);
+    else
+	pov_mesh_write(&mesh, NULL);
+    pov_mesh_free(&mesh);
+}
+
+
+/**
+ * @brief Export an ARS as a mesh2 of triangle strips between
+ * consecutive waterline curves.
+ *
+ * Each curve is a closed loop of pts_per_curve points.  Curves that
+ * collapse to a single point, as the end caps usually do, share one
+ * vertex so their strips close into fans.
+ */
+static void
+pov_ars(struct directory *dp, const struct rt_ars_internal *arip, const struct bn_tol *tol)
+{
+    struct pov_mesh mesh = POV_MESH_INIT_ZERO;
+    size_t npts = arip->pts_per_curve;
+    size_t *first;
+    int *pinched;
+    size_t i, j;
+
+    if (arip->ncurves < 2 || npts < 2) {
+	pov_log(POV_LOG_WARN, "g-pov: ARS %s has too few curves or points, skipped\n", dp->d_namep);
+	return;
+    }
+
+    first = (size_t *)bu_malloc(arip->ncurves * sizeof(size_t), "ars curves");
+    pinched = (int *)bu_malloc(arip->ncurves * sizeof(int), "ars pinched");
+    for (i = 0; i < arip->ncurves; i++) {
+	const fastf_t *cv = arip->curves[i];
+
+	pinched[i] = 1;
+	for (j = 1; j < npts && pinched[i]; j++)
+	    pinched[i] = VNEAR_EQUAL(&cv[j * 3], cv, tol->dist);
+
+	first[i] = pov_mesh_vert(&mesh, cv);
+	for (j = 1; j < npts && !pinched[i]; j++)
+	    (void)pov_mesh_vert(&mesh, &cv[j * 3]);
+    }
+
+    for (i = 0; i + 1 < arip->ncurves; i++) {
+	for (j = 0; j < npts; j++) {
+	    size_t jn = (j + 1) % npts;
+	    size_t a0 = first[i] + (pinched[i] ? 0 : j);
+	    size_t a1 = first[i] + (pinched[i] ? 0 : jn);
+	    size_t b0 = first[i + 1] + (pinched[i + 1] ? 0 : j);
+	    size_t b1 = first[i + 1] + (pinched[i + 1] ? 0 : jn);
+
+	    pov_mesh_tri(&mesh, a0, b0, b1);
+	    pov_mesh_tri(&mesh, a0, b1, a1);
+	}
+    }
+
+    if (mesh.nfaces == 0)
+	pov_log(POV_LOG_WARN, "g-pov: ARS %s has no area, skipped\n", dp->d_namep);
+    else
+	pov_mesh_write(&mesh, NULL);
+
+    pov_mesh_free(&mesh);
+    bu_free(first, "ars curves");
+    bu_free(pinched, "ars pinched");
+}
+
+
+/* hash key of a point's exact coordinates */
+static uint64_t
+pov_point_key(const fastf_t *pt)
+{
+    uint64_t key = 0;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+	double d = pt[i];
+	uint64_t bits;
+
+	/* fold -0 into 0 so both land on the same vertex */
+	if (ZERO(d))
+	    d = 0.0;
+	memcpy(&bits, &d, sizeof(bits));
+	key = (key ^ bits) * 0x100000001b3ULL;
+	key ^= key >> 29;
+    }
+
+    return key;
+}
+
+
+/**
+ * @brief Export a polysolid as a shared vertex mesh2.
+ *
+ * Vertices repeated between faces are merged on their exact
+ * coordinates; a hash collision only costs a duplicate vertex.  Faces
+ * with more than three points are ear clipped so that concave
+ * polygons come out right.
+ */
+static void
+pov_pg(struct directory *dp, const struct rt_pg_internal *pgp)
+{
+    struct pov_mesh mesh = POV_MESH_INIT_ZERO;
+    struct pov_vhash vhash;
+    size_t *loopv;
+    size_t maxv = pgp->max_npts + 1;
+    size_t i, j;
+
+    if (pgp->npoly == 0) {
+	pov_log(POV_LOG_WARN, "g-pov: polysolid %s has no faces, skipped\n", dp->d_namep);
+	return;
+    }
+
+    pov_vhash_init(&vhash, 1024);
+    loopv = (size_t *)pov_scratch(maxv * sizeof(size_t));
+    for (i = 0; i < pgp->npoly; i++) {
+	const struct rt_pg_face_internal *fp = &pgp->poly[i];
+
+	if (fp->npts > maxv) {
+	    maxv = fp->npts;
+	    loopv = (size_t *)pov_scratch(maxv * sizeof(size_t));
+	}
+
+	for (j = 0; j < fp->npts; j++) {
+	    const fastf_t *pt = &fp->verts[j * 3];
+	    long idx = pov_vhash_lookup(&vhash, pov_point_key(pt), (long)mesh.nverts);
+
+	    if (idx == (long)mesh.nverts || !VEQUAL(&mesh.verts[idx * 3], pt))
+		idx = (long)pov_mesh_vert(&mesh, pt);
+	    loopv[j] = (size_t)idx;
+	}
+
+	if (fp->npts == 3)
+	    pov_mesh_tri(&mesh, loopv[0], loopv[1], loopv[2]);
+	else
+	    pov_tess_face(&mesh, &scratch, loopv, &fp->npts, 1, NULL);
+    }
+
+    pov_mesh_write(&mesh, NULL);
+
+    pov_vhash_free(&vhash);
+    pov_mesh_free(&mesh);
+}
+
+
+/* most grid steps along one Bezier span of a tessellated NURB */
+#define NURB_MAXSTEPS 64
+
+/* a NURB surface refined into a net of Bezier patches */
+struct nurb_bez {
+    int ku, kv;			/* orders in u and v */
+    int nc;			/* coordinates per control point */
+    int nu, nv;			/* net columns (u) and rows (v) */
+    fastf_t *net;		/* nv rows of nu points */
+    int nsu, nsv;		/* Bezier spans in u and v */
+    int *su, *sv;		/* first net column/row of each span */
+};
+#define NURB_BEZ_PT(_bp, _row, _col) (&(_bp)->net[((size_t)(_row) * (_bp)->nu + (_col)) * (_bp)->nc])
+
+
+/**
+ * @brief Insert the knot value u once into a curve of *n control
+ * points with nc coordinates each (Boehm's algorithm).  t and p must
+ * have room for one more knot and one more point.
+ */
+static void
+nurb_insert(fastf_t *t, fastf_t *p, int *n, int k, int nc, fastf_t u)
+{
+    int nk = *n + k;
+    int i = 0;
+    int j, c;
+
+    /* last knot strictly before u */
+    for (j = 0; j < nk; j++) {
+	if (t[j] < u)
+	    i = j;
+    }
+
+    memmove(&p[(i + 1) * nc], &p[i * nc], (*n - i) * nc * sizeof(fastf_t));
+    for (j = i; j >= i - k + 2 && j >= 1; j--) {
+	fastf_t a = (u - t[j]) / (t[j + k - 1] - t[j]);
+
+	for (c = 0; c < nc; c++)
+	    p[j * nc + c] = (1.0 - a) * p[(j - 1) * nc + c] + a * p[j * nc + c];
+    }
+    memmove(&t[i + 2], &t[i + 1], (nk - i - 1) * sizeof(fastf_t));
+    t[i + 1] = u;
+    (*n)++;
+}
+
+
+/**
+ * @brief Refine a curve until every knot in its domain has
+ * multiplicity k - 1, so that each non-empty knot span holds one
+ * Bezier segment.  Room for ksize * (k - 1) more knots and points is
+ * needed.
+ */
+static void
+nurb_bezier_refine(fastf_t *t, fastf_t *p, int *n, int k, int nc)
+{
+    int i = k - 1;
+
+    while (i <= *n) {
+	fastf_t u = t[i];
+	int m = 0;
+	int j;
+
+	for (j = 0; j < *n + k; j++) {
+	    if (ZERO(t[j] - u))
+		m++;
+	}
+	for (; m < k - 1; m++)
+	    nurb_insert(t, p, n, k, nc, u);
+
+	while (i <= *n && ZERO(t[i] - u))
+	    i++;
+    }
+}
+
+
+/* first control point of each Bezier span of a refined curve */
+static int
+nurb_spans(int **spans, const fastf_t *t, int n, int k)
+{
+    int i, cnt = 0;
+
+    *spans = (int *)bu_malloc((n + 1) * sizeof(int), "nurb spans");
+    for (i = k - 1; i < n; i++) {
+	if (t[i] < t[i + 1])
+	    (*spans)[cnt++] = i - k + 1;
+    }
+
+    return cnt;
+}
+
+
+/**
+ * @brief Split a NURB surface into Bezier patches by knot insertion,
+ * first along every row (u), then along every column (v).  Control
+ * points of rational surfaces stay homogeneous.
+ */
+static int
+nurb_decompose(struct nurb_bez *bp, const struct face_g_snurb *srf)
+{
+    int ku = srf->order[0];
+    int kv = srf->order[1];
+    int rows = srf->s_size[0];
+    int cols = srf->s_size[1];
+    int nc = RT_NURB_EXTRACT_COORDS(srf->pt_type);
+    int capu = cols + srf->u.k_size * (ku - 1);
+    int capv = rows + srf->v.k_size * (kv - 1);
+    int cap = (capu > capv) ? capu : capv;
+    int kcap = srf->u.k_size * ku + srf->v.k_size * kv;
+    fastf_t *t, *p, *net;
+    int r, c, n = 0;
+
+    memset(bp, 0, sizeof(struct nurb_bez));
+    if (ku < 2 || kv < 2 || nc < 3 || srf->u.k_size != cols + ku || srf->v.k_size != rows + kv)
+	return -1;
+
+    t = (fastf_t *)bu_malloc(kcap * sizeof(fastf_t), "nurb knots");
+    p = (fastf_t *)bu_malloc(cap * nc * sizeof(fastf_t), "nurb curve");
+    net = (fastf_t *)bu_malloc((size_t)rows * capu * nc * sizeof(fastf_t), "nurb rows");
+
+    /* rows first; every row refines to the same width */
+    for (r = 0; r < rows; r++) {
+	n = cols;
+	memcpy(t, srf->u.knots, srf->u.k_size * sizeof(fastf_t));
+	memcpy(p, &srf->ctl_points[(size_t)r * cols * nc], cols * nc * sizeof(fastf_t));
+	nurb_bezier_refine(t, p, &n, ku, nc);
+	memcpy(&net[(size_t)r * n * nc], p, n * nc * sizeof(fastf_t));
+    }
+    bp->nu = n;
+    bp->nsu = nurb_spans(&bp->su, t, n, ku);
+
+    bp->net = (fastf_t *)bu_malloc((size_t)capv * bp->nu * nc * sizeof(fastf_t), "nurb net");
+    for (c = 0; c < bp->nu; c++) {
+	n = rows;
+	memcpy(t, srf->v.knots, srf->v.k_size * sizeof(fastf_t));
+	for (r = 0; r < rows; r++)
+	    memcpy(&p[r * nc], &net[((size_t)r * bp->nu + c) * nc], nc * sizeof(fastf_t));
+	nurb_bezier_refine(t, p, &n, kv, nc);
+	for (r = 0; r < n; r++)
+	    memcpy(&bp->net[((size_t)r * bp->nu + c) * nc], &p[r * nc], nc * sizeof(fastf_t));
+    }
+    bp->nv = n;
+    bp->nsv = nurb_spans(&bp->sv, t, n, kv);
+
+    bp->ku = ku;
+    bp->kv = kv;
+    bp->nc = nc;
+
+    bu_free(t, "nurb knots");
+    bu_free(p, "nurb curve");
+    bu_free(net, "nurb rows");
+
+    return 0;
+}
+
+
+static void
+nurb_bez_free(struct nurb_bez *bp)
+{
+    if (bp->net)
+	bu_free(bp->net, "nurb net");
+    if (bp->su)
+	bu_free(bp->su, "nurb spans");
+    if (bp->sv)
+	bu_free(bp->sv, "nurb spans");
+}
+
+
+/* raise a Bezier segment of k = 2..4 points to a cubic */
+static void
+nurb_to_cubic(fastf_t q[4][3], const fastf_t *p[4], int k)
+{
+    int c;
+
+    for (c = 0; c < 3; c++) {
+	if (k == 2) {
+	    q[0][c] = p[0][c];
+	    q[1][c] = (2.0 * p[0][c] + p[1][c]) / 3.0;
+	    q[2][c] = (p[0][c] + 2.0 * p[1][c]) / 3.0;
+	    q[3][c] = p[1][c];
+	} else if (k == 3) {
+	    q[0][c] = p[0][c];
+	    q[1][c] = (p[0][c] + 2.0 * p[1][c]) / 3.0;
+	    q[2][c] = (2.0 * p[1][c] + p[2][c]) / 3.0;
+	    q[3][c] = p[2][c];
+	} else {
+	    q[0][c] = p[0][c];
+	    q[1][c] = p[1][c];
+	    q[2][c] = p[2][c];
+	    q[3][c] = p[3][c];
+	}
+    }
+}
+
+
+/**
+ * @brief Write Bezier patch (a, b) as a bicubic_patch.  POV-Ray
+ * subdivides these itself, down to the given flatness.  A lone patch
+ * carries its own material.
+ */
+static void
+nurb_bicubic(const struct nurb_bez *bp, int a, int b, fastf_t flatness, int lone)
+{
+    fastf_t rowq[4][4][3];
+    fastf_t q[4][3];
+    const fastf_t *p[4];
+    int i, j, c;
+
+    for (i = 0; i < bp->kv; i++) {
+	for (j = 0; j < bp->ku; j++)
+	    p[j] = NURB_BEZ_PT(bp, bp->sv[b] + i, bp->su[a] + j);
+	nurb_to_cubic(rowq[i], p, bp->ku);
+    }
+
+    pov_printf("\tbicubic_patch { type 0 flatness %g u_steps 4 v_steps 4", flatness);
+    for (j = 0; j < 4; j++) {
+	for (i = 0; i < bp->kv; i++)
+	    p[i] = rowq[i][j];
+	nurb_to_cubic(q, p, bp->kv);
+	for (i = 0; i < 4; i++) {
+	    for (c = 0; c < 3; c++)
+		rowq[i][j][c] = q[i][c];
+	}
+    }
+    for (i = 0; i < 4; i++) {
+	pov_printf("%s\n\t\t", i ? "," : "");
+	for (j = 0; j < 4; j++)
+	    pov_printf("%s<%g, %g, %g>", j ? ", " : "", V3ARGS(rowq[i][j]));
+    }
+    if (lone)
+	pov_printf("\n\tmaterial { %s }", pov_mat);
+    pov_printf("\n\t}\n");
+}
+
+
+/* steps needed along one direction of a Bezier patch for the
+ * tessellation to stay within tol of the surface
+ */
+static int
+nurb_steps(const struct nurb_bez *bp, int a, int b, int udir, fastf_t tol)
+{
+    int k = udir ? bp->ku : bp->kv;
+    int other = udir ? bp->kv : bp->ku;
+    fastf_t m = 0.0;
+    int i, j, n;
+
+    if (k < 3)
+	return 1;
+
+    for (i = 0; i < other; i++) {
+	for (j = 0; j + 2 < k; j++) {
+	    point_t pt[3];
+	    vect_t d;
+	    fastf_t len;
+	    int l;
+
+	    for (l = 0; l < 3; l++) {
+		const fastf_t *cp = udir ? NURB_BEZ_PT(bp, bp->sv[b] + i, bp->su[a] + j + l)
+		    : NURB_BEZ_PT(bp, bp->sv[b] + j + l, bp->su[a] + i);
+		fastf_t w = (bp->nc > 3 && !ZERO(cp[3])) ? 1.0 / cp[3] : 1.0;
+
+		VSCALE(pt[l], cp, w);
+	    }
+	    VADD2(d, pt[0], pt[2]);
+	    VJOIN1(d, d, -2.0, pt[1]);
+	    len = MAGNITUDE(d);
+	    V_MAX(m, len);
+	}
+    }
+
+    /* a degree d Bezier is within d(d-1)/8 * max|second difference|
+     * of its chord over each of n steps, divided by n squared
+     */
+    n = (int)ceil(sqrt((k - 1) * (k - 2) * m / (8.0 * tol)));
+    if (n < 1)
+	n = 1;
+    if (n > NURB_MAXSTEPS)
+	n = NURB_MAXSTEPS;
+
+    return n;
+}
+
+
+/* one NURB surface being tessellated onto a parameter grid */
+struct nurb_tess {
+    struct nurb_bez bez;
+    int *ustep, *vstep;		/* grid steps of each span */
+    int *u0, *v0;		/* first grid column/row of each span */
+    int gu, gv;			/* grid columns and rows */
+    fastf_t *grid;		/* gv rows of gu points */
+};
+
+struct nurb_job {
+    struct nurb_tess *st;
+    int a, b;
+};
+
+
+/* de Casteljau evaluation of k homogeneous points at t, using tmp */
+static void
+nurb_casteljau(fastf_t *out, const fastf_t *pts, int k, int nc, fastf_t t, fastf_t *tmp)
+{
+    int i, j, c;
+
+    memcpy(tmp, pts, k * nc * sizeof(fastf_t));
+    for (j = 1; j < k; j++) {
+	for (i = 0; i < k - j; i++) {
+	    for (c = 0; c < nc; c++)
+		tmp[i * nc + c] = (1.0 - t) * tmp[i * nc + c] + t * tmp[(i + 1) * nc + c];
+	}
+    }
+    memcpy(out, tmp, nc * sizeof(fastf_t));
+}
+
+
+/**
+ * @brief bu_parallel() worker evaluating one Bezier patch per job.
+ *
+ * Each patch owns the grid points of its own spans, leaving the
+ * shared far edge to its neighbour, so no two jobs write the same
+ * point.
+ */
+static void
+nurb_tess_patches(int cpu, void *arg)
+{
+    int64_t start = pov_trace_begin();
+    struct pov_work *wp = (struct pov_work *)arg;
+    struct nurb_job *jobs = (struct nurb_job *)wp->data;
+    struct pov_arena *ap = &worker_scratch[cpu];
+    fastf_t *rowpt = NULL;
+    fastf_t *colpt = NULL;
+    fastf_t *tmp = NULL;
+    size_t maxpt = 0;
+    size_t job;
+
+    pov_arena_reset(ap);
+
+    while ((job = pov_work_next(wp)) < wp->njobs) {
+	struct nurb_tess *st = jobs[job].st;
+	const struct nurb_bez *bp = &st->bez;
+	int a = jobs[job].a;
+	int b = jobs[job].b;
+	int nu = st->ustep[a] + (a == bp->nsu - 1);
+	int nv = st->vstep[b] + (b == bp->nsv - 1);
+	size_t k = (bp->ku > bp->kv) ? bp->ku : bp->kv;
+	int i, j, r;
+
+	if (k * bp->nc > maxpt) {
+	    maxpt = k * bp->nc;
+	    rowpt = (fastf_t *)pov_arena_alloc(ap, maxpt * sizeof(fastf_t));
+	    colpt = (fastf_t *)pov_arena_alloc(ap, maxpt * sizeof(fastf_t));
+	    tmp = (fastf_t *)pov_arena_alloc(ap, maxpt * sizeof(fastf_t));
+	}
+
+	for (i = 0; i < nv; i++) {
+	    fastf_t v = (fastf_t)i / st->vstep[b];
+	    fastf_t *gp = &st->grid[((size_t)(st->v0[b] + i) * st->gu + st->u0[a]) * 3];
+
+	    for (j = 0; j < nu; j++, gp += 3) {
+		fastf_t u = (fastf_t)j / st->ustep[a];
+		fastf_t hp[4];
+
+		for (r = 0; r < bp->kv; r++) {
+		    int l;
+
+		    for (l = 0; l < bp->ku; l++)
+			memcpy(&rowpt[l * bp->nc], NURB_BEZ_PT(bp, bp->sv[b] + r, bp->su[a] + l), bp->nc * sizeof(fastf_t));
+		    nurb_casteljau(&colpt[r * bp->nc], rowpt, bp->ku, bp->nc, u, tmp);
+		}
+		nurb_casteljau(hp, colpt, bp->kv, bp->nc, v, tmp);
+
+		if (bp->nc > 3 && !ZERO(hp[3])) {
+		    VSCALE(gp, hp, 1.0 / hp[3]);
+		} else {
+		    VMOVE(gp, hp);
+		}
+	    }
+	}
+    }
+
+    pov_trace_end("nurb patches", "tessellate", cpu + 1, start);
+}
+
+
+/**
+ * @brief Export a NURB solid.
+ *
+ * Every surface is split into Bezier patches by knot insertion.
+ * Non-rational patches of cubic or lower order become bicubic_patch
+ * objects, which POV-Ray subdivides on demand.  Rational and higher
+ * order surfaces are tessellated on a parameter grid whose spacing is
+ * picked per span from the flatness tolerance (-a, or -r relative to
+ * the solid's size), patch by patch in parallel.  Neighbouring
+ * patches share their grid edges so the mesh has no cracks.
+ */
+static void
+pov_bspline(struct directory *dp, const struct rt_nurb_internal *sip, const struct rt_tess_tol *ttol, int ncpu)
+{
+    struct nurb_tess *tess;
+    struct nurb_job *jobs = NULL;
+    struct pov_mesh mesh = POV_MESH_INIT_ZERO;
+    struct pov_work work;
+    size_t njobs = 0;
+    size_t npatch = 0;
+    fastf_t tol, flatness;
+    point_t lo, hi;
+    int s, a, b, i, j;
+
+    if (sip->nsrf <= 0) {
+	pov_log(POV_LOG_WARN, "g-pov: NURB %s has no surfaces, skipped\n", dp->d_namep);
+	return;
+    }
+
+    tess = (struct nurb_tess *)bu_calloc(sip->nsrf, sizeof(struct nurb_tess), "nurb tess");
+    VSETALL(lo, MAX_FASTF);
+    VSETALL(hi, -MAX_FASTF);
+    for (s = 0; s < sip->nsrf; s++) {
+	struct nurb_bez *bp = &tess[s].bez;
+
+	if (nurb_decompose(bp, sip->srfs[s]) < 0) {
+	    pov_log(POV_LOG_WARN, "g-pov: NURB %s surface %d is malformed, skipped\n", dp->d_namep, s);
+	    continue;
+	}
+	for (i = 0; i < bp->nu * bp->nv; i++) {
+	    const fastf_t *cp = &bp->net[i * bp->nc];
+	    fastf_t w = (bp->nc > 3 && !ZERO(cp[3])) ? 1.0 / cp[3] : 1.0;
+	    point_t pt;
+
+	    VSCALE(pt, cp, w);
+	    VMINMAX(lo, hi, pt);
+	}
+	if (bp->nc == 3 && bp->ku <= 4 && bp->kv <= 4)
+	    npatch += bp->nsu * bp->nsv;
+	else
+	    njobs += bp->nsu * bp->nsv;
+    }
+
+    if (ttol->abs > 0.0)
+	tol = ttol->abs;
+    else
+	tol = ((ttol->rel > 0.0) ? ttol->rel : 0.01) * DIST_PT_PT(lo, hi);
+    if (tol <= 0.0)
+	tol = 1.0;
+    flatness = (ttol->rel > 0.0) ? ttol->rel : 0.01;
+
+    if (njobs) {
+	jobs = (struct nurb_job *)bu_malloc(njobs * sizeof(struct nurb_job), "nurb jobs");
+	njobs = 0;
+	for (s = 0; s < sip->nsrf; s++) {
+	    struct nurb_tess *st = &tess[s];
+	    struct nurb_bez *bp = &st->bez;
+
+	    if (!bp->net || (bp->nc == 3 && bp->ku <= 4 && bp->kv <= 4))
+		continue;
+
+	    st->ustep = (int *)bu_calloc(bp->nsu * 2 + bp->nsv * 2, sizeof(int), "nurb steps");
+	    st->u0 = st->ustep + bp->nsu;
+	    st->vstep = st->u0 + bp->nsu;
+	    st->v0 = st->vstep + bp->nsv;
+
+	    /* a span is stepped as finely as its most curved patch */
+	    for (a = 0; a < bp->nsu; a++) {
+		for (b = 0; b < bp->nsv; b++) {
+		    int us = nurb_steps(bp, a, b, 1, tol);
+		    int vs = nurb_steps(bp, a, b, 0, tol);
+
+		    V_MAX(st->ustep[a], us);
+		    V_MAX(st->vstep[b], vs);
+		    jobs[njobs].st = st;
+		    jobs[njobs].a = a;
+		    jobs[njobs].b = b;
+		    njobs++;
+		}
+	    }
+	    for (a = 0, st->gu = 1; a < bp->nsu; a++) {
+		st->u0[a] = st->gu - 1;
+		st->gu += st->ustep[a];
+	    }
+	    for (b = 0, st->gv = 1; b < bp->nsv; b++) {
+		st->v0[b] = st->gv - 1;
+		st->gv += st->vstep[b];
+	    }
+	    st->grid = (fastf_t *)bu_malloc((size_t)st->gu * st->gv * 3 * sizeof(fastf_t), "nurb grid");
+	}
+
+	work.next = 0;
+	work.njobs = njobs;
+	work.data = jobs;
+	bu_parallel(nurb_tess_patches, ncpu, &work);
+
+	for (s = 0; s < sip->nsrf; s++) {
+	    struct nurb_tess *st = &tess[s];
+	    size_t base = mesh.nverts;
+
+	    if (!st->grid)
+		continue;
+
+	    for (i = 0; i < st->gu * st->gv; i++)
+		pov_mesh_vert(&mesh, &st->grid[i * 3]);
+	    for (i = 0; i + 1 < st->gv; i++) {
+		for (j = 0; j + 1 < st->gu; j++) {
+		    size_t p00 = base + (size_t)i * st->gu + j;
+		    size_t p01 = p00 + 1;
+		    size_t p10 = p00 + st->gu;
+		    size_t p11 = p10 + 1;
+		    const fastf_t *v = mesh.verts;
+
+		    /* skip the slivers where an edge collapses to a pole */
+		    if (!VEQUAL(&v[p00 * 3], &v[p01 * 3]) && !VEQUAL(&v[p01 * 3], &v[p11 * 3])
+			&& !VEQUAL(&v[p00 * 3], &v[p11 * 3]))
+			pov_mesh_tri(&mesh, p00, p01, p11);
+		    if (!VEQUAL(&v[p00 * 3], &v[p11 * 3]) && !VEQUAL(&v[p11 * 3], &v[p10 * 3])
+			&& !VEQUAL(&v[p00 * 3], &v[p10 * 3]))
+			pov_mesh_tri(&mesh, p00, p11, p10);
+		}
+	    }
+	    bu_free(st->grid, "nurb grid");
+	    bu_free(st->ustep, "nurb steps");
+	}
+	bu_free(jobs, "nurb jobs");
+    }
+
+    if (npatch + (mesh.nfaces > 0) > 1)
+	pov_printf("union {\n");
+    for (s = 0; s < sip->nsrf; s++) {
+	struct nurb_bez *bp = &tess[s].bez;
+
+	if (bp->net && bp->nc == 3 && bp->ku <= 4 && bp->kv <= 4) {
+	    for (b = 0; b < bp->nsv; b++)
+		for (a = 0; a < bp->nsu; a++)
+		    nurb_bicubic(bp, a, b, flatness, npatch == 1 && mesh.nfaces == 0);
+	}
+	nurb_bez_free(bp);
+    }
+    pov_mesh_write(&mesh, NULL);
+    if (npatch + (mesh.nfaces > 0) > 1)
+	pov_printf("\tmaterial { %s }\n}\n", pov_mat);
+
+    pov_mesh_free(&mesh);
+    bu_free(tess, "nurb tess");
+}
+
+
+/**
+ * @brief A sketch turned into closed loops of cubic Bezier pieces, four
+ * 2D points per piece, as POV-Ray's bezier_spline wants them.
+ */
+struct pov_outline {
+    size_t npts, maxpts;
+    fastf_t *pts;		/* x, y pairs */
+    size_t nloops, maxloops;
+    size_t *loops;		/* first point of each loop */
+    int linear;			/* every piece is a straight line */
+};
+#define POV_OUTLINE_INIT_ZERO {0, 0, NULL, 0, 0, NULL, 1}
+
+
+static void
+outline_piece(struct pov_outline *op, const fastf_t *p0, const fastf_t *p1, const fastf_t *p2, const fastf_t *p3)
+{
+    if (op->npts + 4 > op->maxpts) {
+	op->maxpts = op->maxpts ? op->maxpts * 2 : 64;
+	op->pts = (fastf_t *)bu_realloc(op->pts, op->maxpts * 2 * sizeof(fastf_t), "outline pts");
+    }
+    V2MOVE(&op->pts[op->npts * 2], p0);
+    V2MOVE(&op->pts[op->npts * 2 + 2], p1);
+    V2MOVE(&op->pts[op->npts * 2 + 4], p2);
+    V2MOVE(&op->pts[op->npts * 2 + 6], p3);
+    op->npts += 4;
+}
+
+
+static void
+outline_line(struct pov_outline *op, const fastf_t *a, const fastf_t *b)
+{
+    point2d_t p1, p2;
+
+    p1[X] = (2.0 * a[X] + b[X]) / 3.0;
+    p1[Y] = (2.0 * a[Y] + b[Y]) / 3.0;
+    p2[X] = (a[X] + 2.0 * b[X]) / 3.0;
+    p2[Y] = (a[Y] + 2.0 * b[Y]) / 3.0;
+    outline_piece(op, a, p1, p2, b);
+}
+
+
+/**
+ * @brief Append a circular arc as cubic pieces of at most 90 degrees.
+ *
+ * A negative radius marks a full circle through "start" about the
+ * vertex "end"; otherwise the center lies to the left of the chord
+ * when center_is_left is set.  Orientation 0 runs counter-clockwise.
+ */
+static void
+outline_carc(struct pov_outline *op, const struct rt_sketch_internal *skt, const struct carc_seg *csg)
+{
+    const fastf_t *s = skt->verts[csg->start];
+    const fastf_t *e = skt->verts[csg->end];
+    point2d_t c, p0, p1, p2, p3;
+    fastf_t r, a0, sweep;
+    int n, i;
+
+    if (csg->radius <= 0.0) {
+	V2MOVE(c, e);
+	r = sqrt((s[X] - c[X]) * (s[X] - c[X]) + (s[Y] - c[Y]) * (s[Y] - c[Y]));
+	sweep = csg->orientation ? -M_2PI : M_2PI;
+	e = s;
+    } else {
+	fastf_t dx = e[X] - s[X];
+	fastf_t dy = e[Y] - s[Y];
+	fastf_t half = sqrt(dx * dx + dy * dy) / 2.0;
+	fastf_t off;
+	fastf_t a1;
+
+	r = csg->radius;
+	off = (r > half) ? sqrt(r * r - half * half) : 0.0;
+	if (!csg->center_is_left)
+	    off = -off;
+	c[X] = (s[X] + e[X]) / 2.0 - off * dy / (2.0 * half);
+	c[Y] = (s[Y] + e[Y]) / 2.0 + off * dx / (2.0 * half);
+
+	a1 = atan2(e[Y] - c[Y], e[X] - c[X]);
+	sweep = a1 - atan2(s[Y] - c[Y], s[X] - c[X]);
+	if (csg->orientation) {
+	    while (sweep >= 0.0)
+		sweep -= M_2PI;
+	} else {
+	    while (sweep <= 0.0)
+		sweep += M_2PI;
+	}
+    }
+
+    a0 = atan2(s[Y] - c[Y], s[X] - c[X]);
+    n = (int)ceil(fabs(sweep) / M_PI_2 - 1e-9);
+    if (n < 1)
+	n = 1;
+    V2MOVE(p0, s);
+    for (i = 1; i <= n; i++) {
+	fastf_t a = a0 + sweep * (i - 1) / n;
+	fastf_t b = a0 + sweep * i / n;
+	fastf_t k = 4.0 / 3.0 * tan((b - a) / 4.0) * r;
+
+	if (i == n) {
+	    V2MOVE(p3, e);
+	} else {
+	    p3[X] = c[X] + r * cos(b);
+	    p3[Y] = c[Y] + r * sin(b);
+	}
+	p1[X] = p0[X] - k * sin(a);
+	p1[Y] = p0[Y] + k * cos(a);
+	p2[X] = p3[X] + k * sin(b);
+	p2[Y] = p3[Y] - k * cos(b);
+	outline_piece(op, p0, p1, p2, p3);
+	V2MOVE(p0, p3);
+    }
+}
+
+
+/**
+ * @brief Append a Bezier segment.  Up to cubic it is exact; higher
+ * degrees are split in eight and each part replaced by the cubic with
+ * the same end points and end tangents.
+ */
+static void
+outline_bezier(struct pov_outline *op, const struct rt_sketch_internal *skt, const struct bezier_seg *bsg)
+{
+    int d = bsg->degree;
+    point2d_t p1, p2;
+    int i, j, l;
+
+    if (d == 1) {
+	outline_line(op, skt->verts[bsg->ctl_points[0]], skt->verts[bsg->ctl_points[1]]);
+    } else if (d == 2) {
+	const fastf_t *a = skt->verts[bsg->ctl_points[0]];
+	const fastf_t *m = skt->verts[bsg->ctl_points[1]];
+	const fastf_t *b = skt->verts[bsg->ctl_points[2]];
+
+	p1[X] = (a[X] + 2.0 * m[X]) / 3.0;
+	p1[Y] = (a[Y] + 2.0 * m[Y]) / 3.0;
+	p2[X] = (2.0 * m[X] + b[X]) / 3.0;
+	p2[Y] = (2.0 * m[Y] + b[Y]) / 3.0;
+	outline_piece(op, a, p1, p2, b);
+    } else if (d == 3) {
+	outline_piece(op, skt->verts[bsg->ctl_points[0]], skt->verts[bsg->ctl_points[1]],
+		      skt->verts[bsg->ctl_points[2]], skt->verts[bsg->ctl_points[3]]);
+    } else {
+	point2d_t *w = (point2d_t *)bu_malloc((d + 1) * sizeof(point2d_t), "bezier split");
+
+	for (i = 0; i < 8; i++) {
+	    fastf_t t0 = i / 8.0;
+	    fastf_t t1 = (i == 7) ? 1.0 : 1.0 / (8 - i);
+
+	    /* the part right of t0, then the part of that left of t1,
+	     * both by de Casteljau
+	     */
+	    for (j = 0; j <= d; j++)
+		V2MOVE(w[j], skt->verts[bsg->ctl_points[j]]);
+	    for (j = 1; j <= d; j++) {
+		for (l = 0; l <= d - j; l++) {
+		    w[l][X] = (1.0 - t0) * w[l][X] + t0 * w[l + 1][X];
+		    w[l][Y] = (1.0 - t0) * w[l][Y] + t0 * w[l + 1][Y];
+		}
+	    }
+	    for (j = 1; j <= d; j++) {
+		for (l = d; l >= j; l--) {
+		    w[l][X] = (1.0 - t1) * w[l - 1][X] + t1 * w[l][X];
+		    w[l][Y] = (1.0 - t1) * w[l - 1][Y] + t1 * w[l][Y];
+		}
+	    }
+
+	    p1[X] = w[0][X] + d / 3.0 * (w[1][X] - w[0][X]);
+	    p1[Y] = w[0][Y] + d / 3.0 * (w[1][Y] - w[0][Y]);
+	    p2[X] = w[d][X] - d / 3.0 * (w[d][X] - w[d - 1][X]);
+	    p2[Y] = w[d][Y] - d / 3.0 * (w[d][Y] - w[d - 1][Y]);
+	    outline_piece(op, w[0], p1, p2, w[d]);
+	}
+	bu_free(w, "bezier split");
+    }
+}
+
+
+/* first and last sketch vertex of segment i, honouring its reverse flag */
+static int
+outline_ends(const struct rt_sketch_internal *skt, size_t i, int *start, int *end)
+{
+    const void *seg = skt->curve.segment[i];
+    uint32_t magic = *(const uint32_t *)seg;
+
+    switch (magic) {
+	case CURVE_LSEG_MAGIC:
+	    *start = ((const struct line_seg *)seg)->start;
+	    *end = ((const struct line_seg *)seg)->end;
+	    break;
+	case CURVE_CARC_MAGIC:
+	    *start = ((const struct carc_seg *)seg)->start;
+	    *end = ((const struct carc_seg *)seg)->end;
+	    if (((const struct carc_seg *)seg)->radius <= 0.0)
+		*end = *start;
+	    break;
+	case CURVE_BEZIER_MAGIC:
+	    *start = ((const struct bezier_seg *)seg)->ctl_points[0];
+	    *end = ((const struct bezier_seg *)seg)->ctl_points[((const struct bezier_seg *)seg)->degree];
+	    break;
+	default:
+	    return -1;
+    }
+    if (skt->curve.reverse && skt->curve.reverse[i]) {
+	int t = *start;
+	*start = *end;
+	*end = t;
+    }
+
+    return 0;
+}
+
+
+/* append segment i, flipping it end for end when "flip" is set */
+static void
+outline_segment(struct pov_outline *op, const struct rt_sketch_internal *skt, size_t i, int flip)
+{
+    const void *seg = skt->curve.segment[i];
+    size_t first = op->npts;
+    size_t a, b;
+
+    switch (*(const uint32_t *)seg) {
+	case CURVE_LSEG_MAGIC:
+	    outline_line(op, skt->verts[((const struct line_seg *)seg)->start],
+			 skt->verts[((const struct line_seg *)seg)->end]);
+	    break;
+	case CURVE_CARC_MAGIC:
+	    outline_carc(op, skt, (const struct carc_seg *)seg);
+	    op->linear = 0;
+	    break;
+	case CURVE_BEZIER_MAGIC:
+	    outline_bezier(op, skt, (const struct bezier_seg *)seg);
+	    if (((const struct bezier_seg *)seg)->degree > 1)
+		op->linear = 0;
+	    break;
+    }
+
+    if (skt->curve.reverse && skt->curve.reverse[i])
+	flip = !flip;
+    if (!flip)
+	return;
+
+    /* reversing every point reverses both the pieces and their order */
+    for (a = first, b = op->npts - 1; a < b; a++, b--) {
+	point2d_t t;
+
+	V2MOVE(t, &op->pts[a * 2]);
+	V2MOVE(&op->pts[a * 2], &op->pts[b * 2]);
+	V2MOVE(&op->pts[b * 2], t);
+    }
+}
+
+
+static int
+outline_same(const struct rt_sketch_internal *skt, int a, int b, fastf_t dist)
+{
+    return a == b
+	|| (fabs(skt->verts[a][X] - skt->verts[b][X]) < dist
+	    && fabs(skt->verts[a][Y] - skt->verts[b][Y]) < dist);
+}
+
+
+/**
+ * @brief Chain the segments of a sketch into closed loops of cubic
+ * pieces.  Segments may be stored in any order and either direction.
+ * Returns -1 if a segment type is unsupported or a loop does not
+ * close.
+ */
+static int
+pov_sketch_outline(struct pov_outline *op, const struct rt_sketch_internal *skt, fastf_t dist)
+{
+    size_t n = skt->curve.count;
+    int *used;
+    size_t i, j;
+    int ret = 0;
+
+    if (n == 0)
+	return -1;
+
+    for (i = 0; i < n; i++) {
+	int s, e;
+
+	if (outline_ends(skt, i, &s, &e) < 0)
+	    return -1;
+    }
+
+    used = (int *)bu_calloc(n, sizeof(int), "outline used");
+    for (i = 0; i < n && ret == 0; i++) {
+	int loop_start, end, s, e;
+
+	if (used[i])
+	    continue;
+
+	if (op->nloops >= op->maxloops) {
+	    op->maxloops = op->maxloops ? op->maxloops * 2 : 8;
+	    op->loops = (size_t *)bu_realloc(op->loops, op->maxloops * sizeof(size_t), "outline loops");
+	}
+	op->loops[op->nloops++] = op->npts;
+
+	used[i] = 1;
+	(void)outline_ends(skt, i, &loop_start, &end);
+	outline_segment(op, skt, i, 0);
+
+	while (!outline_same(skt, end, loop_start, dist)) {
+	    for (j = 0; j < n; j++) {
+		if (used[j])
+		    continue;
+		(void)outline_ends(skt, j, &s, &e);
+		if (outline_same(skt, s, end, dist)) {
+		    outline_segment(op, skt, j, 0);
+		    end = e;
+		    break;
+		}
+		if (outline_same(skt, e, end, dist)) {
+		    outline_segment(op, skt, j, 1);
+		    end = s;
+		    break;
+		}
+	    }
+	    if (j == n) {
+		ret = -1;
+		break;
+	    }
+	    used[j] = 1;
+	}
+    }
+    bu_free(used, "outline used");
+
+    return ret;
+}
+
+
+static void
+pov_outline_free(struct pov_outline *op)
+{
+    if (op->pts)
+	bu_free(op->pts, "outline pts");
+    if (op->loops)
+	bu_free(op->loops, "outline loops");
+}
+
+
+/**
+ * @brief Write an outline's spline points for a prism (with heights
+ * 0 and 1) or a lathe.  All straight outlines become a linear_spline,
+ * closing each loop by repeating its first point; anything else is a
+ * bezier_spline.  A lathe's linear_spline is a single polyline, so a
+ * lathe with several loops always uses bezier_spline.
+ */
+static void
+pov_outline_points(const struct pov_outline *op, int prism)
+{
+    const char *heights = prism ? "0, 1, " : "";
+    size_t count = 0;
+    size_t i, l;
+
+    if (op->linear && (prism || op->nloops == 1)) {
+	count = op->npts / 4 + op->nloops;
+	pov_printf("\tlinear_spline\n\t%s%lu", heights, (unsigned long)count);
+	for (l = 0, count = 0; l < op->nloops; l++) {
+	    size_t end = (l + 1 < op->nloops) ? op->loops[l + 1] : op->npts;
+
+	    for (i = op->loops[l]; i < end; i += 4, count++)
+		pov_printf(",%s<%g, %g>", (count % 6) ? " " : "\n\t\t", V2ARGS(&op->pts[i * 2]));
+	    pov_printf(",%s<%g, %g>", (count++ % 6) ? " " : "\n\t\t", V2ARGS(&op->pts[op->loops[l] * 2]));
+	}
+    } else {
+	pov_printf("\tbezier_spline\n\t%s%lu", heights, (unsigned long)op->npts);
+	for (i = 0; i < op->npts; i++)
+	    pov_printf(",%s<%g, %g>", (i % 4) ? " " : "\n\t\t", V2ARGS(&op->pts[i * 2]));
+    }
+    pov_printf("\n");
+}
+
+
+/**
+ * @brief Find the sketch a primitive refers to.  Normally librt has
+ * already attached it; otherwise it is read into "intern", which the
+ * caller frees if idb_ptr is set.
+ */
+static struct rt_sketch_internal *
+pov_get_sketch(struct directory *dp, struct rt_sketch_internal *skt, const char *name, const struct db_i *dbip, struct rt_db_internal *intern)
+{
+    struct directory *sdp;
+
+    RT_DB_INTERNAL_INIT(intern);
+    if (skt)
+	return skt;
+
+    sdp = db_lookup(dbip, name, LOOKUP_QUIET);
+    if (sdp == RT_DIR_NULL || rt_db_get_internal(intern, sdp, dbip, bn_mat_identity, &rt_uniresource) < 0) {
+	pov_log(POV_LOG_WARN, "g-pov: sketch %s of %s not found, skipped\n", name, dp->d_namep);
+	return NULL;
+    }
+    if (intern->idb_type != ID_SKETCH) {
+	pov_log(POV_LOG_WARN, "g-pov: %s of %s is not a sketch, skipped\n", name, dp->d_namep);
+	rt_db_free_internal(intern);
+	intern->idb_ptr = NULL;
+	return NULL;
+    }
+
+    return (struct rt_sketch_internal *)intern->idb_ptr;
+}
+
+
+/**
+ * @brief Export an extrusion as a prism.
+ *
+ * The sketch's lines, arcs and Bezier segments become a linear or
+ * bezier_spline outline that POV-Ray intersects analytically.  The
+ * prism is built in its own X/Z plane from height 0 to 1 and the
+ * matrix carries X to u_vec, Y to h and Z to v_vec, placed at V.
+ */
+static void
+pov_extrude(struct directory *dp, struct rt_extrude_internal *eip, const struct db_i *dbip, const struct bn_tol *tol)
+{
+    struct pov_outline outline = POV_OUTLINE_INIT_ZERO;
+    struct rt_db_internal sintern;
+    struct rt_sketch_internal *skt;
+    mat_t m;
+
+    skt = pov_get_sketch(dp, eip->skt, eip->sketch_name, dbip, &sintern);
+    if (!skt)
+	return;
+
+    if (pov_sketch_outline(&outline, skt, tol->dist) < 0) {
+	pov_log(POV_LOG_WARN, "g-pov: sketch of extrusion %s is not closed or has unsupported segments, skipped\n", dp->d_namep);
+    } else {
+	pov_printf("prism {\n");
+	pov_outline_points(&outline, 1);
+	pov_unit_frame(m, eip->V, eip->u_vec, eip->h, eip->v_vec);
+	pov_matrix(m);
+	pov_printf("\tmaterial { %s }\n}\n", pov_mat);
+    }
+
+    pov_outline_free(&outline);
+    if (sintern.idb_ptr)
+	rt_db_free_internal(&sintern);
+}
+
+
+/**
+ * @brief Export a revolved sketch as a lathe.
+ *
+ * The lathe turns its X/Y profile about its own Y axis, so the matrix
+ * takes X to r, Y to the axis and Z to axis x r, the direction librt
+ * sweeps in.  A profile drawn on the negative side of the axis is
+ * mirrored and the frame turned half way round to match.  A partial
+ * revolution is cut down to the wedge between the start plane and the
+ * plane at the revolve angle, which keeps the cut faces solid where
+ * clipped_by would leave them open.
+ */
+static void
+pov_revolve(struct directory *dp, struct rt_revolve_internal *rip, const struct db_i *dbip, const struct bn_tol *tol)
+{
+    struct pov_outline outline = POV_OUTLINE_INIT_ZERO;
+    struct rt_db_internal sintern;
+    struct rt_sketch_internal *skt;
+    vect_t xdir, ydir, zdir;
+    fastf_t ang = rip->ang;
+    int pos = 0, neg = 0;
+    size_t i;
+    mat_t m;
+
+    skt = pov_get_sketch(dp, rip->skt, bu_vls_addr(&rip->sketch_name), dbip, &sintern);
+    if (!skt)
+	return;
+
+    if (pov_sketch_outline(&outline, skt, tol->dist) < 0) {
+	pov_log(POV_LOG_WARN, "g-pov: sketch of revolve %s is not closed or has unsupported segments, skipped\n", dp->d_namep);
+	goto out;
+    }
+
+    for (i = 0; i < outline.npts; i++) {
+	if (outline.pts[i * 2] > tol->dist)
+	    pos = 1;
+	else if (outline.pts[i * 2] < -tol->dist)
+	    neg = 1;
+    }
+    if (pos && neg) {
+	pov_log(POV_LOG_WARN, "g-pov: profile of revolve %s crosses its axis, skipped\n", dp->d_namep);
+	goto out;
+    }
+
+    VMOVE(xdir, rip->r);
+    VUNITIZE(xdir);
+    VMOVE(ydir, rip->axis3d);
+    VUNITIZE(ydir);
+    VCROSS(zdir, ydir, xdir);
+    if (neg) {
+	for (i = 0; i < outline.npts; i++)
+	    outline.pts[i * 2] = -outline.pts[i * 2];
+	VREVERSE(xdir, xdir);
+	VREVERSE(zdir, zdir);
+    }
+    pov_unit_frame(m, rip->v3d, xdir, ydir, zdir);
+
+    if (ang <= 0.0 || ang >= M_2PI - SMALL_FASTF) {
+	pov_printf("lathe {\n");
+	pov_outline_points(&outline, 0);
+    } else {
+	/* angles run from X towards Z; the start plane keeps z >= 0 and
+	 * the end plane keeps the half turn leading up to the angle
+	 */
+	pov_printf("intersection {\n\tlathe {\n");
+	pov_outline_points(&outline, 0);
+	pov_printf("\t}\n");
+	if (ang > M_PI)
+	    pov_printf("\tunion {\n\t");
+	pov_printf("\tplane { <0, 0, -1>, 0 }\n");
+	if (ang > M_PI)
+	    pov_printf("\t");
+	pov_printf("\tplane { <%g, 0, %g>, 0 }\n", -sin(ang), cos(ang));
+	if (ang > M_PI)
+	    pov_printf("\t}\n");
+    }
+    pov_matrix(m);
+    pov_printf("\tmaterial { %s }\n}\n", pov_mat);
+
+out:
+    pov_outline_free(&outline);
+    if (sintern.idb_ptr)
+	rt_db_free_internal(&sintern);
+}
+
+
+/**
+ * @brief Blob component radius and strength for one metaball control
+ * point, or -1 if the point has no volume on its own.
+ *
+ * librt and POV-Ray use different field functions, so the point is
+ * matched on the radius it would have alone: the distance rs where
+ * librt's field falls to the threshold.  The component radius R is
+ * the support of the Nishimura function for the metaball method, and
+ * 2 rs for the unbounded isopotential and Blinn fields.  The strength
+ * puts POV's (1 - (r/R)^2)^2 falloff on the threshold at rs.
+ */
+static int
+metaball_component(const struct rt_metaball_internal *mb, const struct wdb_metaballpt *mbpt, fastf_t *radius, fastf_t *strength)
+{
+    fastf_t t = mb->threshold;
+    fastf_t f = fabs(mbpt->fldstr);
+    fastf_t rs, q;
+
+    switch (mb->method) {
+	case METABALL_METABALL:
+	    /* 1 - 3 (r/f)^2 inside f/3, 1.5 (1 - r/f)^2 out to f */
+	    if (t >= 1.0)
+		return -1;
+	    if (t >= 2.0 / 3.0)
+		rs = f * sqrt((1.0 - t) / 3.0);
+	    else
+		rs = f * (1.0 - sqrt(2.0 * t / 3.0));
+	    *radius = f;
+	    break;
+	case METABALL_ISOPOTENTIAL:
+	    /* f^2 / r^2 */
+	    rs = f / sqrt(t);
+	    *radius = 2.0 * rs;
+	    break;
+	case METABALL_BLOB:
+	    /* exp(sweat - sweat (r/f)^2) */
+	    if (mbpt->sweat <= 0.0 || 1.0 - log(t) / mbpt->sweat <= 0.0)
+		return -1;
+	    rs = f * sqrt(1.0 - log(t) / mbpt->sweat);
+	    *radius = 2.0 * rs;
+	    break;
+	default:
+	    return -1;
+    }
+    if (rs <= 0.0 || *radius <= 0.0)
+	return -1;
+
+    q = 1.0 - (rs / *radius) * (rs / *radius);
+    *strength = t / (q * q);
+    if (mbpt->fldstr < 0.0 && mb->method != METABALL_METABALL)
+	*strength = -*strength;
+
+    return 0;
+}
+
+
+/**
+ * @brief Export a metaball as a POV-Ray blob, which POV-Ray solves
+ * directly within the components' bounding spheres.  Isolated balls
+ * come out exact; blending between balls is close but not identical.
+ */
+static void
+pov_metaball(struct directory *dp, const struct rt_metaball_internal *mb)
+{
+    const struct wdb_metaballpt *mbpt;
+    fastf_t radius, strength;
+    int count = 0;
+
+    if (mb->method != METABALL_METABALL && mb->method != METABALL_ISOPOTENTIAL && mb->method != METABALL_BLOB) {
+	pov_log(POV_LOG_WARN, "g-pov: metaball %s uses unknown method %d, skipped\n", dp->d_namep, mb->method);
+	return;
+    }
+    if (mb->threshold <= 0.0) {
+	pov_log(POV_LOG_WARN, "g-pov: metaball %s has a threshold of %g, skipped\n", dp->d_namep, mb->threshold);
+	return;
+    }
+
+    for (BU_LIST_FOR(mbpt, wdb_metaballpt, &mb->metaball_ctrl_head)) {
+	if (metaball_component(mb, mbpt, &radius, &strength) == 0)
+	    count++;
+    }
+    if (count == 0) {
+	pov_log(POV_LOG_WARN, "g-pov: metaball %s has no control points with any volume, skipped\n", dp->d_namep);
+	return;
+    }
+
+    pov_printf("blob {\n\tthreshold %g\n", mb->threshold);
+    for (BU_LIST_FOR(mbpt, wdb_metaballpt, &mb->metaball_ctrl_head)) {
+	if (metaball_component(mb, mbpt, &radius, &strength) == 0)
+	    pov_printf("\tsphere { <%g, %g, %g>, %g, strength %g }\n", V3ARGS(mbpt->coord), radius, strength);
+    }
+    pov_printf("\tmaterial { %s }\n}\n", pov_mat);
+}
+
+
+/**
+ * @brief Superellipsoid.
+ *
+ * librt's surface ((x^(2/e) + y^(2/e))^(e/n) + z^(2/n) = 1 in unit
+ * space) is exactly POV-Ray's superellipsoid {<e, n>}, so only the
+ * frame taking the unit cube onto A, B and C at V is needed.
+ */
+static void
+pov_superell(struct directory *dp, const struct rt_superell_internal *sip)
+{
+    mat_t m;
+
+    if (sip->n <= 0.0 || sip->e <= 0.0) {
+	pov_log(POV_LOG_WARN, "g-pov: superellipsoid %s has exponents %g and %g, skipped\n", dp->d_namep, sip->n, sip->e);
+	return;
+    }
+
+    pov_unit_frame(m, sip->v, sip->a, sip->b, sip->c);
+    pov_printf("superellipsoid {\n\t<%g, %g>\n", sip->e, sip->n);
+    pov_printf("\tbounded_by { box { <-1, -1, -1>, <1, 1, 1> } }\n");
+    pov_matrix(m);
+    pov_printf("\tmaterial { %s }\n}\n", pov_mat);
+}
+
+
+/* clines of the region being walked, written out by pov_cline_flush() */
+static struct bu_vls cline_batch = BU_VLS_INIT_ZERO;
+static size_t cline_count = 0;
+static char cline_mat[sizeof(pov_mat)];
+
+
+/**
+ * @brief Queue a FASTGEN cline for its region's batch.
+ *
+ * Models carry clines by the hundred thousand, so each is one short
+ * macro call, batched until the material changes.  A plate mode
+ * cline (thickness below the radius) is a tube; its inner cylinder
+ * overshoots both ends so that no faces coincide.
+ */
+static void
+pov_cline(struct directory *dp, const struct rt_cline_internal *cip)
+{
+    if (cip->radius <= 0.0 || MAGSQ(cip->h) <= SMALL_FASTF) {
+	pov_log(POV_LOG_WARN, "g-pov: cline %s has no volume, skipped\n", dp->d_namep);
+	return;
+    }
+
+    /* the batch is written later, so declare its material now */
+    pov_mat_use();
+    if (cline_count > 0 && !BU_STR_EQUAL(cline_mat, pov_mat))
+	pov_cline_flush();
+    bu_strlcpy(cline_mat, pov_mat, sizeof(cline_mat));
+
+    if (cip->thickness > 0.0 && cip->thickness < cip->radius)
+	bu_vls_printf(&cline_batch, "\tCline_Plate(<%g, %g, %g>, <%g, %g, %g>, %g, %g)\n",
+		      V3ARGS(cip->v), V3ARGS(cip->h), cip->radius, cip->thickness);
+    else
+	bu_vls_printf(&cline_batch, "\tCline(<%g, %g, %g>, <%g, %g, %g>, %g)\n",
+		      V3ARGS(cip->v), V3ARGS(cip->h), cip->radius);
+    cline_count++;
+}
+
+
+/**
+ * @brief Write the queued clines as one union sharing their declared
+ * material.  The macros are declared on first use.
+ */
+static void
+pov_cline_flush(void)
+{
+    static int declared = 0;
+    int64_t start;
+
+    if (cline_count == 0)
+	return;
+    start = pov_trace_begin();
+
+    if (!declared) {
+	pov_printf("#macro Cline(V, H, R)\n\tcylinder { V, V + H, R }\n#end\n");
+	pov_printf("#macro Cline_Plate(V, H, R, T)\n");
+	pov_printf("\tdifference {\n\t\tcylinder { V, V + H, R }\n");
+	pov_printf("\t\tcylinder { V - H * 0.001, V + H * 1.001, R - T }\n\t}\n#end\n");
+	declared = 1;
+    }
+
+    pov_printf("%s {\n%s\tmaterial { %s }\n}\n", (cline_count > 1) ? "union" : "object", bu_vls_addr(&cline_batch), cline_mat);
+
+    bu_vls_trunc(&cline_batch, 0);
+    cline_count = 0;
+    pov_trace_end("clines", "flush", 0, start);
+}
+
+
+/* one point of a point cloud, flattened out of its typed list */
+struct pnts_rec {
+    point_t v;
+    fastf_t r;
+    fastf_t rgb[3];
+    uint64_t key;
+};
+
+
+/* spread the low 21 bits of x to every third bit */
+static uint64_t
+pnts_spread(uint64_t x)
+{
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffULL;
+    x = (x | x << 16) & 0x1f0000ff0000ffULL;
+    x = (x | x << 8) & 0x100f00f00f00f00fULL;
+    x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+    x = (x | x << 2) & 0x1249249249249249ULL;
+
+    return x;
+}
+
+
+static int
+pnts_cmp(const void *a, const void *b)
+{
+    uint64_t ka = ((const struct pnts_rec *)a)->key;
+    uint64_t kb = ((const struct pnts_rec *)b)->key;
+
+    return (ka > kb) - (ka < kb);
+}
+
+
+/* position, radius and color of one list node of the given type */
+static int
+pnts_get(struct pnts_rec *rp, const struct pnt *node, rt_pnt_type type, fastf_t scale)
+{
+    const struct bu_color *cp = NULL;
+
+    VMOVE(rp->v, node->v);
+    rp->r = scale;
+    switch (type) {
+	case RT_PNT_TYPE_PNT:
+	case RT_PNT_TYPE_NRM:
+	    break;
+	case RT_PNT_TYPE_COL:
+	    cp = &((const struct pnt_color *)node)->c;
+	    break;
+	case RT_PNT_TYPE_SCA:
+	    rp->r = ((const struct pnt_scale *)node)->s;
+	    break;
+	case RT_PNT_TYPE_COL_SCA:
+	    cp = &((const struct pnt_color_scale *)node)->c;
+	    rp->r = ((const struct pnt_color_scale *)node)->s;
+	    break;
+	case RT_PNT_TYPE_COL_NRM:
+	    cp = &((const struct pnt_color_normal *)node)->c;
+	    break;
+	case RT_PNT_TYPE_SCA_NRM:
+	    rp->r = ((const struct pnt_scale_normal *)node)->s;
+	    break;
+	case RT_PNT_TYPE_COL_SCA_NRM:
+	    cp = &((const struct pnt_color_scale_normal *)node)->c;
+	    rp->r = ((const struct pnt_color_scale_normal *)node)->s;
+	    break;
+    }
+    if (cp)
+	bu_color_to_rgb_floats(cp, rp->rgb);
+
+    return cp != NULL;
+}
+
+
+/**
+ * @brief Export a point cloud through a data file.
+ *
+ * Writing a sphere statement per point makes gigabytes of scene text,
+ * so positions, radii and colors go to a comma separated sidecar file
+ * that a short #fopen/#read/#while loop turns into instances of one
+ * declared sphere.  The file starts with the number of groups; each
+ * group gives its point count and bounding box, then its points.
+ * With -G the points are sorted along a Morton curve and cut into
+ * groups of that many, each a union bounded by its box, so POV-Ray
+ * can skip whole patches of the cloud.
+ */
+static void
+pov_pnts(struct directory *dp, const struct rt_pnts_internal *pnts, size_t group)
+{
+    struct bu_vls path = BU_VLS_INIT_ZERO;
+    struct pnts_rec *recs;
+    const struct pnt *head = (const struct pnt *)pnts->point;
+    const struct pnt *node;
+    size_t count = 0;
+    size_t ngroups, g, i, base;
+    int color = 0;
+    point_t lo, hi;
+    FILE *fp;
+
+    if (!head || pnts->count == 0) {
+	pov_log(POV_LOG_WARN, "g-pov: point cloud %s is empty, skipped\n", dp->d_namep);
+	return;
+    }
+
+    recs = (struct pnts_rec *)bu_malloc(pnts->count * sizeof(struct pnts_rec), "pnts recs");
+    VSETALL(lo, MAX_FASTF);
+    VSETALL(hi, -MAX_FASTF);
+    for (BU_LIST_FOR(node, pnt, &head->l)) {
+	struct pnts_rec *rp = &recs[count];
+
+	if (count >= pnts->count)
+	    break;
+	color |= pnts_get(rp, node, pnts->type, pnts->scale);
+	if (rp->r <= 0.0)
+	    continue;
+	VMINMAX(lo, hi, rp->v);
+	count++;
+    }
+    if (count == 0) {
+	pov_log(POV_LOG_WARN, "g-pov: points of %s have no radius, skipped\n", dp->d_namep);
+	bu_free(recs, "pnts recs");
+	return;
+    }
+
+    if (group == 0 || group > count)
+	group = count;
+    if (group < count) {
+	vect_t span;
+
+	VSUB2(span, hi, lo);
+	for (i = 0; i < 3; i++) {
+	    if (span[i] <= 0.0)
+		span[i] = 1.0;
+	}
+	for (i = 0; i < count; i++) {
+	    uint64_t q[3];
+	    int k;
+
+	    for (k = 0; k < 3; k++)
+		q[k] = (uint64_t)((recs[i].v[k] - lo[k]) / span[k] * 2097151.0);
+	    recs[i].key = pnts_spread(q[X]) | pnts_spread(q[Y]) << 1 | pnts_spread(q[Z]) << 2;
+	}
+	qsort(recs, count, sizeof(struct pnts_rec), pnts_cmp);
+    }
+    ngroups = (count + group - 1) / group;
+
+    if (pov_sidecar_name(&path, &base, dp, ".csv")) {
+	fp = fopen(bu_vls_addr(&path), "w");
+	if (!fp) {
+	    pov_log(POV_LOG_WARN, "g-pov: unable to create point file %s\n", bu_vls_addr(&path));
+	    bu_vls_free(&path);
+	    bu_free(recs, "pnts recs");
+	    return;
+	}
+	fprintf(fp, "%lu", (unsigned long)ngroups);
+	for (g = 0; g < ngroups; g++) {
+	    size_t first = g * group;
+	    size_t last = (first + group < count) ? first + group : count;
+	    point_t glo, ghi;
+
+	    VSETALL(glo, MAX_FASTF);
+	    VSETALL(ghi, -MAX_FASTF);
+	    for (i = first; i < last; i++) {
+		point_t p;
+
+		VSUB2SCALAR(p, recs[i].v, recs[i].r);
+		VMINMAX(glo, ghi, p);
+		VADD2SCALAR(p, recs[i].v, recs[i].r);
+		VMINMAX(glo, ghi, p);
+	    }
+	    fprintf(fp, ",\n%lu, %g, %g, %g, %g, %g, %g", (unsigned long)(last - first), V3ARGS(glo), V3ARGS(ghi));
+	    for (i = first; i < last; i++) {
+		fprintf(fp, ",\n%g, %g, %g, %g", V3ARGS(recs[i].v), recs[i].r);
+		if (color)
+		    fprintf(fp, ", %g, %g, %g", V3ARGS(recs[i].rgb));
+	    }
+	}
+	fprintf(fp, "\n");
+	if (fclose(fp) != 0)
+	    pov_log(POV_LOG_WARN, "g-pov: error writing point file %s\n", bu_vls_addr(&path));
+    }
+
+    pov_printf("#fopen Pnts_File \"%s\" read\n", bu_vls_addr(&path) + base);
+    pov_printf("#read (Pnts_File, Pnts_Groups)\n");
+    pov_printf("#declare Pnts_Sphere = sphere { <0, 0, 0>, 1 }\n");
+    pov_printf("union {\n\t#declare Pnts_G = 0;\n\t#while (Pnts_G < Pnts_Groups)\n");
+    pov_printf("\t\t#read (Pnts_File, Pnts_N, Pnts_X0, Pnts_Y0, Pnts_Z0, Pnts_X1, Pnts_Y1, Pnts_Z1)\n");
+    pov_printf("\t\tunion {\n\t\t\t#declare Pnts_I = 0;\n\t\t\t#while (Pnts_I < Pnts_N)\n");
+    if (color) {
+	pov_printf("\t\t\t\t#read (Pnts_File, Pnts_X, Pnts_Y, Pnts_Z, Pnts_R, Pnts_Cr, Pnts_Cg, Pnts_Cb)\n");
+	pov_printf("\t\t\t\tobject { Pnts_Sphere scale Pnts_R translate <Pnts_X, Pnts_Y, Pnts_Z> pigment { rgb <Pnts_Cr, Pnts_Cg, Pnts_Cb> } }\n");
+    } else {
+	pov_printf("\t\t\t\t#read (Pnts_File, Pnts_X, Pnts_Y, Pnts_Z, Pnts_R)\n");
+	pov_printf("\t\t\t\tobject { Pnts_Sphere scale Pnts_R translate <Pnts_X, Pnts_Y, Pnts_Z> }\n");
+    }
+    pov_printf("\t\t\t\t#declare Pnts_I = Pnts_I + 1;\n\t\t\t#end\n");
+    pov_printf("\t\t\tbounded_by { box { <Pnts_X0, Pnts_Y0, Pnts_Z0>, <Pnts_X1, Pnts_Y1, Pnts_Z1> } }\n");
+    pov_printf("\t\t}\n\t\t#declare Pnts_G = Pnts_G + 1;\n\t#end\n");
+    pov_printf("\tmaterial { %s }\n}\n#fclose Pnts_File\n", pov_mat);
+
+    bu_vls_free(&path);
+    bu_free(recs, "pnts recs");
+}
+
+
+/* librt pads extruded bitmaps by two empty cells on every side */
+#define EBM_XWIDEN 2
+#define EBM_YWIDEN 2
+#define EBM_BIT(_eip, _xx, _yy) \
+    ((unsigned char *)((_eip)->mp->apbuf))[((_yy)+EBM_YWIDEN)*((_eip)->xdim + EBM_XWIDEN*2)+(_xx)+EBM_XWIDEN]
+
+/* runs of solid cells found on one bitmap scanline, as x0, x1 pairs */
+struct ebm_row {
+    size_t nruns;
+    uint32_t *runs;
+};
+
+struct ebm_scan {
+    const struct rt_ebm_internal *eip;
+    struct ebm_row *rows;
+};
+
+
+/**
+ * @brief bu_parallel() worker that run length encodes bitmap scanlines.
+ */
+static void
+ebm_scan_rows(int cpu, void *arg)
+{
+    int64_t start = pov_trace_begin();
+    struct pov_work *wp = (struct pov_work *)arg;
+    const struct rt_ebm_internal *eip = ((struct ebm_scan *)wp->data)->eip;
+    struct ebm_row *rows = ((struct ebm_scan *)wp->data)->rows;
+    size_t y;
+
+    while ((y = pov_work_next(wp)) < wp->njobs) {
+	struct ebm_row *rp = &rows[y];
+	size_t max = 0;
+	uint32_t x = 0;
+
+	while (x < eip->xdim) {
+	    uint32_t x0;
+
+	    if (!EBM_BIT(eip, x, y)) {
+		x++;
+		continue;
+	    }
+	    for (x0 = x; x < eip->xdim && EBM_BIT(eip, x, y); x++)
+		;
+	    if (rp->nruns >= max) {
+		max = max ? max * 2 : 8;
+		rp->runs = (uint32_t *)bu_realloc(rp->runs, max * 2 * sizeof(uint32_t), "ebm runs");
+	    }
+	    rp->runs[rp->nruns * 2] = x0;
+	    rp->runs[rp->nruns * 2 + 1] = x;
+	    rp->nruns++;
+	}
+    }
+    pov_trace_end("ebm rows", "tessellate", cpu + 1, start);
+}
+
+
+/**
+ * @brief Convert an extruded bitmap into a union of boxes.
+ *
+ * Scanlines are run length encoded in parallel, then runs with the
+ * same extent on consecutive scanlines are merged into one box, so a
+ * solid rectangle of cells becomes a single box however large it is.
+ */
+static void
+pov_ebm(struct directory *dp, const struct rt_ebm_internal *eip, int ncpu)
+{
+    struct ebm_scan scan;
+    struct pov_work work;
+    uint32_t *open, *next, *tmp;	/* boxes growing in y: x0, x1, y0 */
+    size_t nopen = 0;
+    size_t nruns = 0;
+    size_t y;
+
+    if (!eip->mp || !eip->mp->apbuf || eip->xdim == 0 || eip->ydim == 0) {
+	pov_log(POV_LOG_WARN, "g-pov: EBM %s has no bitmap data, skipped\n", dp->d_namep);
+	return;
+    }
+
+    scan.eip = eip;
+    scan.rows = (struct ebm_row *)bu_calloc(eip->ydim, sizeof(struct ebm_row), "ebm rows");
+    work.next = 0;
+    work.njobs = eip->ydim;
+    work.data = &scan;
+    bu_parallel(ebm_scan_rows, ncpu, &work);
+
+    for (y = 0; y < eip->ydim; y++)
+	nruns += scan.rows[y].nruns;
+    if (nruns == 0) {
+	pov_log(POV_LOG_WARN, "g-pov: EBM %s is empty, skipped\n", dp->d_namep);
+	bu_free(scan.rows, "ebm rows");
+	return;
+    }
+
+    /* a row never holds more than xdim/2 + 1 runs */
+    open = (uint32_t *)bu_malloc((eip->xdim / 2 + 1) * 3 * sizeof(uint32_t), "ebm open boxes");
+    next = (uint32_t *)bu_malloc((eip->xdim / 2 + 1) * 3 * sizeof(uint32_t), "ebm open boxes");
+
+    pov_printf("union {\n");
+    for (y = 0; y <= eip->ydim; y++) {
+	/* the row past the end is empty, closing every open box */
+	const struct ebm_row *rp = (y < eip->ydim) ? &scan.rows[y] : NULL;
+	size_t count = rp ? rp->nruns : 0;
+	size_t nnext = 0;
+	size_t i = 0;
+	size_t j = 0;
+
+	/* both lists are sorted on x0, walk them together */
+	while (i < nopen || j < count) {
+	    const uint32_t *op = &open[i * 3];
+	    const uint32_t *run = (j < count) ? &rp->runs[j * 2] : NULL;
+
+	    if (i < nopen && run && op[0] == run[0] && op[1] == run[1]) {
+		/* same extent as the box below, grow it */
+		memcpy(&next[nnext++ * 3], op, 3 * sizeof(uint32_t));
+		i++;
+		j++;
+	    } else if (i < nopen && (!run || op[0] <= run[0])) {
+		pov_printf("\tbox { <%u, %u, 0>, <%u, %lu, %g> }\n",
+		       op[0], op[2], op[1], (unsigned long)y, eip->tallness);
+		i++;
+	    } else {
+		next[nnext * 3] = run[0];
+		next[nnext * 3 + 1] = run[1];
+		next[nnext * 3 + 2] = (uint32_t)y;
+		nnext++;
+		j++;
+	    }
+	}
+
+	tmp = open;
+	open = next;
+	next = tmp;
+	nopen = nnext;
+    }
+    pov_matrix(eip->mat);
+    pov_printf("\tmaterial { %s }\n}\n", pov_mat);
+
+    for (y = 0; y < eip->ydim; y++) {
+	if (scan.rows[y].runs)
+	    bu_free(scan.rows[y].runs, "ebm runs");
+    }
+    bu_free(scan.rows, "ebm rows");
+    bu_free(open, "ebm open boxes");
+    bu_free(next, "ebm open boxes");
+}
+
+
+/* librt pads volume maps by two empty cells on every side */
+#define VOL_XWIDEN 2
+#define VOL_YWIDEN 2
+#define VOL_ZWIDEN 2
+#define VOL_CELL(_vip, _xx, _yy, _zz) \
+    (_vip)->map[(((_zz)+VOL_ZWIDEN)*((_vip)->ydim + VOL_YWIDEN*2)+((_yy)+VOL_YWIDEN))*((_vip)->xdim + VOL_XWIDEN*2)+(_xx)+VOL_XWIDEN]
+
+/* quads found on one slice between voxel layers: u0, v0, width,
+ * height and the sign of the face normal along the slice axis
+ */
+struct vol_slice {
+    size_t nquads;
+    size_t max;
+    int *quads;
+};
+
+struct vol_scan {
+    const struct rt_vol_internal *vip;
+    long dims[3];
+    struct vol_slice *slices;
+};
+
+
+static int
+vol_solid(const struct rt_vol_internal *vip, const long p[3])
+{
+    unsigned char val;
+
+    if (p[X] < 0 || p[Y] < 0 || p[Z] < 0
+	|| p[X] >= (long)vip->xdim || p[Y] >= (long)vip->ydim || p[Z] >= (long)vip->zdim)
+	return 0;
+
+    val = VOL_CELL(vip, p[X], p[Y], p[Z]);
+    return val >= vip->lo && val <= vip->hi;
+}
+
+
+/**
+ * @brief bu_parallel() worker that greedily merges the boundary faces
+ * on each slice between voxel layers into maximal rectangles.
+ *
+ * Slice jobs are numbered through the X, then Y, then Z slices.
+ */
+static void
+vol_scan_slices(int cpu, void *arg)
+{
+    int64_t start = pov_trace_begin();
+    struct pov_work *wp = (struct pov_work *)arg;
+    struct vol_scan *sp = (struct vol_scan *)wp->data;
+    struct pov_arena *ap = &worker_scratch[cpu];
+    signed char *mask = NULL;
+    size_t maskmax = 0;
+    size_t job;
+
+    pov_arena_reset(ap);
+
+    while ((job = pov_work_next(wp)) < wp->njobs) {
+	struct vol_slice *slice = &sp->slices[job];
+	long s = (long)job;
+	long nu, nv, i, j;
+	long p[3];
+	int d, u, v;
+
+	for (d = 0; d < 2 && s > sp->dims[d]; d++)
+	    s -= sp->dims[d] + 1;
+	u = (d + 1) % 3;
+	v = (d + 2) % 3;
+	nu = sp->dims[u];
+	nv = sp->dims[v];
+
+	if ((size_t)(nu * nv) > maskmax) {
+	    maskmax = nu * nv;
+	    mask = (signed char *)pov_arena_alloc(ap, maskmax);
+	}
+
+	/* +1 where a solid voxel below faces an empty one above, -1
+	 * for the reverse
+	 */
+	for (j = 0; j < nv; j++) {
+	    for (i = 0; i < nu; i++) {
+		int below, above;
+
+		p[u] = i;
+		p[v] = j;
+		p[d] = s - 1;
+		below = vol_solid(sp->vip, p);
+		p[d] = s;
+		above = vol_solid(sp->vip, p);
+		mask[j * nu + i] = (below == above) ? 0 : (below ? 1 : -1);
+	    }
+	}
+
+	for (j = 0; j < nv; j++) {
+	    for (i = 0; i < nu;) {
+		signed char c = mask[j * nu + i];
+		long w, h, k;
+		int *qp;
+
+		if (!c) {
+		    i++;
+		    continue;
+		}
+
+		/* widest run along u, then as many rows along v as match */
+		for (w = 1; i + w < nu && mask[j * nu + i + w] == c; w++)
+		    ;
+		for (h = 1; j + h < nv; h++) {
+		    for (k = 0; k < w; k++) {
+			if (mask[(j + h) * nu + i + k] != c)
+			    break;
+		    }
+		    if (k < w)
+			break;
+		}
+		for (k = 0; k < h; k++)
+		    memset(&mask[(j + k) * nu + i], 0, w);
+
+		if (slice->nquads >= slice->max) {
+		    slice->max = slice->max ? slice->max * 2 : 16;
+		    slice->quads = (int *)bu_realloc(slice->quads, slice->max * 5 * sizeof(int), "vol quads");
+		}
+		qp = &slice->quads[slice->nquads++ * 5];
+		qp[0] = (int)i;
+		qp[1] = (int)j;
+		qp[2] = (int)w;
+		qp[3] = (int)h;
+		qp[4] = c;
+
+		i += w;
+	    }
+	}
     }
+
+    pov_trace_end("vol slices", "tessellate", cpu + 1, start);
 }
 
 
+static size_t
+vol_vert(struct pov_mesh *mp, struct pov_vhash *hp, const long p[3])
+{
+    uint64_t key = (uint64_t)p[X] | ((uint64_t)p[Y] << 21) | ((uint64_t)p[Z] << 42);
+    long idx = pov_vhash_lookup(hp, key, (long)mp->nverts);
+
+    if (idx == (long)mp->nverts) {
+	point_t pt;
+
+	VSET(pt, p[X], p[Y], p[Z]);
+	pov_mesh_vert(mp, pt);
+    }
+
+    return (size_t)idx;
+}
+
 
 /**
- * @brief This routine is called when a region is first encountered in the
- * hierarchy when processing a tree
- *
+ * @brief Convert a volume into a greedy meshed mesh2.
  *
- *      @param tsp tree state (for parsing the tree)
- *      @param pathp A listing of all the nodes traversed to get to this node in the database
- *      @param combp the combination record for this region
+ * Only the boundary between solid and empty voxels is meshed, and
+ * coplanar boundary faces are merged into rectangles before being
+ * split into triangles, which typically cuts the face count by an
+ * order of magnitude or more compared to one quad per voxel face.
  */
-int
-region_start(struct db_tree_state *tsp,
-	     const struct db_full_path *pathp,
-	     const struct rt_comb_internal *combp,
-	     void *client_data)
+static void
+pov_vol(struct directory *dp, const struct rt_vol_internal *vip, int ncpu)
 {
-    char *name;
-    struct directory *dp;
-    struct bu_vls str = BU_VLS_INIT_ZERO;
-    struct user_data *your_stuff = (struct user_data *)client_data;
+    struct vol_scan scan;
+    struct pov_work work;
+    struct pov_mesh mesh = POV_MESH_INIT_ZERO;
+    struct pov_vhash vhash;
+    mat_t scale, xform;
+    size_t job;
 
-    RT_CK_DBTS(tsp);
-
-    name = db_path_to_string(pathp);
-    bu_log("region_start %s\n", name);
-    bu_free(name, "reg_start name");
+    if (!vip->map || vip->xdim == 0 || vip->ydim == 0 || vip->zdim == 0) {
+	pov_log(POV_LOG_WARN, "g-pov: VOL %s has no voxel data, skipped\n", dp->d_namep);
+	return;
+    }
+    if (vip->xdim >= (1 << 21) || vip->ydim >= (1 << 21) || vip->zdim >= (1 << 21)) {
+	pov_log(POV_LOG_WARN, "g-pov: VOL %s is too large to mesh, skipped\n", dp->d_namep);
+	return;
+    }
 
-    bu_log("data = %ld\n", your_stuff->data);
-    rt_pr_tol(&your_stuff->tol);
+    scan.vip = vip;
+    scan.dims[X] = vip->xdim;
+    scan.dims[Y] = vip->ydim;
+    scan.dims[Z] = vip->zdim;
+    work.next = 0;
+    work.njobs = vip->xdim + vip->ydim + vip->zdim + 3;
+    work.data = &scan;
+    scan.slices = (struct vol_slice *)bu_calloc(work.njobs, sizeof(struct vol_slice), "vol slices");
+    bu_parallel(vol_scan_slices, ncpu, &work);
 
-    dp = DB_FULL_PATH_CUR_DIR(pathp);
+    pov_vhash_init(&vhash, 1024);
+    for (job = 0; job < work.njobs; job++) {
+	const struct vol_slice *slice = &scan.slices[job];
+	long s = (long)job;
+	size_t q;
+	int d, u, v;
 
-    /* here is where the conversion should be done */
-    if (combp->region_flag)
-	printf("Write this region (name=%s) as a part in your format:\n", dp->d_namep);
-    else
-	printf("Write this combination (name=%s) as an assembly in your format:\n", dp->d_namep);
+	for (d = 0; d < 2 && s > scan.dims[d]; d++)
+	    s -= scan.dims[d] + 1;
+	u = (d + 1) % 3;
+	v = (d + 2) % 3;
 
-    describe_tree(combp->tree, &str);
+	for (q = 0; q < slice->nquads; q++) {
+	    const int *qp = &slice->quads[q * 5];
+	    size_t c[4];
+	    long p[3];
 
-    printf("\t%s\n\n", bu_vls_addr(&str));
+	    p[d] = s;
+	    p[u] = qp[0];
+	    p[v] = qp[1];
+	    c[0] = vol_vert(&mesh, &vhash, p);
+	    p[u] += qp[2];
+	    c[1] = vol_vert(&mesh, &vhash, p);
+	    p[v] += qp[3];
+	    c[2] = vol_vert(&mesh, &vhash, p);
+	    p[u] = qp[0];
+	    c[3] = vol_vert(&mesh, &vhash, p);
 
-    bu_vls_free(&str);
+	    /* u x v points along +d, keep the winding outward */
+	    if (qp[4] > 0) {
+		pov_mesh_tri(&mesh, c[0], c[1], c[2]);
+		pov_mesh_tri(&mesh, c[0], c[2], c[3]);
+	    } else {
+		pov_mesh_tri(&mesh, c[0], c[2], c[1]);
+		pov_mesh_tri(&mesh, c[0], c[3], c[2]);
+	    }
+	}
+	if (slice->quads)
+	    bu_free(slice->quads, "vol quads");
+    }
+    bu_free(scan.slices, "vol slices");
+    pov_vhash_free(&vhash);
 
-    return 0;
+    if (mesh.nfaces == 0) {
+	pov_log(POV_LOG_WARN, "g-pov: VOL %s has no voxels within its thresholds, skipped\n", dp->d_namep);
+    } else {
+	/* lattice points to local millimeters to model space */
+	MAT_IDN(scale);
+	scale[0] = vip->cellsize[X];
+	scale[5] = vip->cellsize[Y];
+	scale[10] = vip->cellsize[Z];
+	bn_mat_mul(xform, vip->mat, scale);
+	pov_mesh_write(&mesh, xform);
+    }
+    pov_mesh_free(&mesh);
 }
 
 
+/* submodel trees already converted, see pov_submodel() */
+struct pov_submodel {
+    struct bu_vls file;		/* database, empty for the one being converted */
+    struct bu_vls treetop;
+    struct db_i *dbip;		/* opened here for another database, else NULL */
+    int id;			/* Submodel_<id>, -1 if the tree could not be read */
+    int busy;			/* being converted, a reference now is a cycle */
+};
+static struct bu_ptbl submodels = BU_PTBL_INIT_ZERO;
+
+
 /**
- * @brief This is called when all sub-elements of a region have been processed by leaf_func.
- *
- *      @param tsp
- *      @param pathp
- *      @param curtree
- *
- *      @return TREE_NULL if data in curtree was "stolen", otherwise db_walk_tree will
- *      clean up the data in the union tree * that is returned
- *
- * If it wants to retain the data in curtree it can by returning TREE_NULL.  Otherwise
- * db_walk_tree will clean up the data in the union tree * that is returned.
+ * @brief Place a SUBMODEL, converting the referenced tree on first use.
  *
+ * Each (file, treetop) pair is walked once, in its own coordinates,
+ * into a declared union.  Every placement after that is an object
+ * reference carrying the submodel's root2leaf matrix, so a tree used
+ * a hundred times is converted and parsed once.
  */
-union tree *
-region_end (struct db_tree_state *tsp,
-	    const struct db_full_path *pathp,
-	    union tree *curtree,
-	    void *UNUSED(client_data))
+static void
+pov_submodel(struct directory *dp, const struct rt_submodel_internal *sip, const struct db_tree_state *tsp, void *client_data)
 {
-    char *name;
+    struct pov_submodel *smp = NULL;
+    struct db_tree_state state;
+    struct bu_vls outer_region;
+    int64_t outer_start, start;
+    struct db_i *dbip;
+    const char *top;
+    size_t i;
 
-    RT_CK_DBTS(tsp);
+    /* a reference draws in the materials of the tree it names */
+    mat_pending = NULL;
 
-    name = db_path_to_string(pathp);
-    bu_log("region_end   %s\n", name);
-    bu_free(name, "region_end name");
+    if (bu_vls_strlen(&sip->treetop) == 0) {
+	pov_log(POV_LOG_WARN, "g-pov: submodel %s names no tree, skipped\n", dp->d_namep);
+	return;
+    }
 
-    return curtree;
-}
+    for (i = 0; i < BU_PTBL_LEN(&submodels); i++) {
+	struct pov_submodel *p = (struct pov_submodel *)BU_PTBL_GET(&submodels, i);
+	if (BU_STR_EQUAL(bu_vls_addr(&p->file), bu_vls_addr(&sip->file))
+	    && BU_STR_EQUAL(bu_vls_addr(&p->treetop), bu_vls_addr(&sip->treetop))) {
+	    smp = p;
+	    break;
+	}
+    }
 
-/*declare torusflag*/
-int flag = 0 ;
-double Vadd[3];
-double maga;
-double magb;
-double magc;
-double magd;
-double Xdir, Ydir, Zdir;
+    if (!smp) {
+	BU_ALLOC(smp, struct pov_submodel);
+	bu_vls_init(&smp->file);
+	bu_vls_init(&smp->treetop);
+	bu_vls_vlscat(&smp->file, &sip->file);
+	bu_vls_vlscat(&smp->treetop, &sip->treetop);
+	smp->id = (int)BU_PTBL_LEN(&submodels);
+	bu_ptbl_ins(&submodels, (long *)smp);
+
+	dbip = tsp->ts_dbip;
+	if (bu_vls_strlen(&smp->file) > 0) {
+	    smp->dbip = db_open(bu_vls_addr(&smp->file), "r");
+	    if (smp->dbip != DBI_NULL && db_dirbuild(smp->dbip) < 0) {
+		db_close(smp->dbip);
+		smp->dbip = DBI_NULL;
+	    }
+	    dbip = smp->dbip;
+	}
+	top = bu_vls_addr(&smp->treetop);
+	if (dbip == DBI_NULL || db_lookup(dbip, top, LOOKUP_QUIET) == RT_DIR_NULL) {
+	    pov_log(POV_LOG_WARN, "g-pov: submodel %s: can not read %s from %s\n", dp->d_namep, top,
+		    bu_vls_strlen(&smp->file) ? bu_vls_addr(&smp->file) : "this database");
+	    smp->id = -1;
+	    return;
+	}
+
+	/* the region being walked keeps its clines out of the declaration */
+	pov_cline_flush();
+	pov_printf("#declare Submodel_%d = union {\n", smp->id);
+
+	state = rt_initial_tree_state;
+	state.ts_dbip = dbip;
+	state.ts_tol = tsp->ts_tol;
+	state.ts_ttol = tsp->ts_ttol;
+	state.ts_resp = tsp->ts_resp;
+
+	/* the enclosing region's span resumes after the nested walk */
+	outer_region = trace_region_name;
+	outer_start = trace_region_start;
+	bu_vls_init(&trace_region_name);
+	trace_region_start = 0;
+	start = pov_trace_begin();
+
+	smp->busy = 1;
+	submodel_depth++;
+	(void)db_walk_tree(dbip, 1, &top, 1, &state, region_start, region_end, primitive_func, client_data);
+	pov_cline_flush();
+	submodel_depth--;
+	smp->busy = 0;
+
+	pov_trace_region(NULL);
+	pov_trace_end(top, "db_walk_tree", 0, start);
+	bu_vls_free(&trace_region_name);
+	trace_region_name = outer_region;
+	trace_region_start = outer_start;
+
+	pov_printf("}\n");
+    } else if (smp->busy) {
+	pov_log(POV_LOG_WARN, "g-pov: submodel %s is part of its own tree %s, skipped\n", dp->d_namep, bu_vls_addr(&smp->treetop));
+	return;
+    }
+
+    if (smp->id < 0)
+	return;
+
+    pov_printf("object { Submodel_%d\n", smp->id);
+    pov_matrix(sip->root2leaf);
+    pov_printf("}\n");
+}
 
 
 /* This routine is called by the tree walker (db_walk_tree)
@@ -232,19 +5323,30 @@ union tree *
 primitive_func(struct db_tree_state *tsp,
 	       const struct db_full_path *pathp,
 	       struct rt_db_internal *ip,
-	       void *UNUSED(client_data))
+	       void *client_data)
 {
     int i;
     size_t j;
     struct directory *dp;
-    char *name;
+    struct user_data *your_stuff = (struct user_data *)client_data;
+    struct pov_frame frame;
+    int outer_phase = alloc_phase;
     dp = DB_FULL_PATH_CUR_DIR(pathp);
 
     RT_CK_DBTS(tsp);
+    pov_capture('P', tsp, pathp, ip);
+    alloc_phase = POV_ALLOC_PRIMITIVE;
+    pov_stats_begin(&frame);
+
+    /* outside any region, nothing else would release the scratch */
+    if (!(tsp->ts_sofar & TS_SOFAR_REGION))
+	pov_scratch_reset();
 
-    name = db_path_to_string(pathp);
-    bu_log("leaf_func    %s\n", name);
-    bu_free(name, "region_end name");
+    if (POV_LOGGING(POV_LOG_INFO))
+	pov_log(POV_LOG_INFO, "leaf_func    %s\n", pov_scratch_path(pathp));
+
+    /* its region's material, declared if the primitive writes anything */
+    mat_pending = &tsp->ts_mater;
 
     /* handle each type of primitive (see h/rtgeom.h) */
     if (ip->idb_major_type == DB5_MAJORTYPE_BRLCAD) {
@@ -256,17 +5358,17 @@ primitive_func(struct db_tree_state *tsp,
 		    struct rt_tor_internal *tor = (struct rt_tor_internal *)ip->idb_ptr;
 		    if ( flag == 0 )
 		    {
-		    printf("#include\"transforms.inc\"\n");
-		    printf("#macro Torus(Center, Normal, Radius1, Radius2)\n");
-		    printf("\t torus{ Radius1, Radius2 Reorient_Trans(y, Normal) translate Center }\n#end\n\n");
+		    pov_printf("#include\"transforms.inc\"\n");
+		    pov_printf("#macro Torus(Center, Normal, Radius1, Radius2)\n");
+		    pov_printf("\t torus{ Radius1, Radius2 Reorient_Trans(y, Normal) translate Center }\n#end\n\n");
 		    flag = 1;
 		    }
-		    printf(" \nobject {\tTorus (\n");
-		    printf("\t< %g, %g, %g>, ", V3ARGS(tor->v));
-		    printf("<%g, %g, %g>, ", V3ARGS(tor->h));
-		    printf(" %g , ", tor->r_a);
-		    printf("%g )", tor->r_h);
-		    printf(" texture{ pigment{ LightBlue} }}\n");
+		    pov_printf(" \nobject {\tTorus (\n");
+		    pov_printf("\t< %g, %g, %g>, ", V3ARGS(tor->v));
+		    pov_printf("<%g, %g, %g>, ", V3ARGS(tor->h));
+		    pov_printf(" %g , ", tor->r_a);
+		    pov_printf("%g )", tor->r_h);
+		    pov_printf(" material { %s }}\n", pov_mat);
 		    break;
 		}
 	    case ID_TGC: /* truncated general cone frustum */
@@ -282,29 +5384,29 @@ primitive_func(struct db_tree_state *tsp,
 	    magd = MAGNITUDE(tgc->d);
 	    if(EQUAL(MAGNITUDE(tgc->a), MAGNITUDE(tgc->c)))     /* Cylender */
 	    { 
-		    printf("\tcylinder\n\t    {\n ");
-		   	printf("\t<%g %g %g>,\n", V3ARGS(tgc->v));
-		  	printf("\t<%g %g %g>,  ", Vadd[0], Vadd[1],Vadd[2]);
-		    printf("%g\n", maga);
-		    printf("\t    texture{ pigment{ lightblue } }}\n");
+		    pov_printf("\tcylinder\n\t    {\n ");
+		   	pov_printf("\t<%g %g %g>,\n", V3ARGS(tgc->v));
+		  	pov_printf("\t<%g %g %g>,  ", Vadd[0], Vadd[1],Vadd[2]);
+		    pov_printf("%g\n", maga);
+		    pov_printf("\t    material { %s }}\n", pov_mat);
 		}  
 		else if(EQUAL(MAGNITUDE(tgc->a), MAGNITUDE(tgc->b))) /* Cone */
 		{
-			printf("\tCone\n\t    {\n ");
-			printf("\t<%g %g %g>,  ", V3ARGS(tgc->v));
-		  	printf("%g,\n", maga);
-			printf("\t    <%g %g %g>,  ", V3ARGS(tgc->h));
-			printf("%g\n", magc);
-			printf("\t    texture{ pigment{ lightblue } }}\n");
+			pov_printf("\tCone\n\t    {\n ");
+			pov_printf("\t<%g %g %g>,  ", V3ARGS(tgc->v));
+		  	pov_printf("%g,\n", maga);
+			pov_printf("\t    <%g %g %g>,  ", V3ARGS(tgc->h));
+			pov_printf("%g\n", magc);
+			pov_printf("\t    material { %s }}\n", pov_mat);
 		}  
 		else
-		{	printf("#include \"shapes.inc\"\n");
-			printf("\tobject{ Supercone(\n");
-			printf("\t<%g, %g, %g>,  ", V3ARGS(tgc->v));
-		  	printf("%g, %g ,\n", maga, magb);
-			printf("<%g, %g, %g>,  ", Vadd[0], Vadd[1],Vadd[2]);
-			printf("%g, %g)", magc, magd);
-			printf("\t    texture{ pigment{ color rgb<0.65,1,0> } }}\n");
+		{	pov_printf("#include \"shapes.inc\"\n");
+			pov_printf("\tobject{ Supercone(\n");
+			pov_printf("\t<%g, %g, %g>,  ", V3ARGS(tgc->v));
+		  	pov_printf("%g, %g ,\n", maga, magb);
+			pov_printf("<%g, %g, %g>,  ", Vadd[0], Vadd[1],Vadd[2]);
+			pov_printf("%g, %g)", magc, magd);
+			pov_printf("\t    material { %s }}\n", pov_mat);
 		}  
 		break;
 		}
@@ -314,13 +5416,13 @@ primitive_func(struct db_tree_state *tsp,
 		     * cones and cylinders
 		     */
 		    struct rt_tgc_internal *tgc = (struct rt_tgc_internal *)ip->idb_ptr;
-		    printf("Write this TGC (name=%s) in your format:\n", dp->d_namep);
-		    printf("\tV=(%g %g %g)\n", V3ARGS(tgc->v));
-		    printf("\tH=(%g %g %g)\n", V3ARGS(tgc->h));
-		    printf("\tA=(%g %g %g)\n", V3ARGS(tgc->a));
-		    printf("\tB=(%g %g %g)\n", V3ARGS(tgc->b));
-		    printf("\tC=(%g %g %g)\n", V3ARGS(tgc->c));
-		    printf("\tD=(%g %g %g)\n", V3ARGS(tgc->d));
+		    pov_printf("Write this TGC (name=%s) in your format:\n", dp->d_namep);
+		    pov_printf("\tV=(%g %g %g)\n", V3ARGS(tgc->v));
+		    pov_printf("\tH=(%g %g %g)\n", V3ARGS(tgc->h));
+		    pov_printf("\tA=(%g %g %g)\n", V3ARGS(tgc->a));
+		    pov_printf("\tB=(%g %g %g)\n", V3ARGS(tgc->b));
+		    pov_printf("\tC=(%g %g %g)\n", V3ARGS(tgc->c));
+		    pov_printf("\tD=(%g %g %g)\n", V3ARGS(tgc->d));
 		    break;
 		}
         case ID_ELL:
@@ -330,40 +5432,27 @@ primitive_func(struct db_tree_state *tsp,
 		    maga = MAGNITUDE(ell->a);
 		    magb = MAGNITUDE(ell->b);
 		    magc = MAGNITUDE(ell->c);
-		    printf("#include \"shapes.inc\"\nobject{\n\t\tSpheroid(\n");
-		    printf("\t<%g, %g, %g>,\n", V3ARGS(ell->v));
-		    printf("< %g ,", magb);
-		    printf(" %g ,", maga);
-		    printf(" %g > )", magc);
-		    printf(" pigment{ LightBlue}\n\t}\n");
+		    pov_printf("#include \"shapes.inc\"\nobject{\n\t\tSpheroid(\n");
+		    pov_printf("\t<%g, %g, %g>,\n", V3ARGS(ell->v));
+		    pov_printf("< %g ,", magb);
+		    pov_printf(" %g ,", maga);
+		    pov_printf(" %g > )", magc);
+		    pov_printf(" material { %s }\n\t}\n", pov_mat);
 		    break;
 		}
 	    case ID_SPH:
 		{
 		    /* spheres*/
 		    struct rt_ell_internal *ell = (struct rt_ell_internal *)ip->idb_ptr;
-		    printf("sphere{\n");
-		    printf("\t<%g, %g, %g>,\n", V3ARGS(ell->v));
-		    printf("\t %g \n//%g%g\n", V3ARGS(ell->a));
-		    printf(" pigment{ LightBlue}\n\t}\n");
+		    pov_printf("sphere{\n");
+		    pov_printf("\t<%g, %g, %g>,\n", V3ARGS(ell->v));
+		    pov_printf("\t %g \n//%g%g\n", V3ARGS(ell->a));
+		    pov_printf(" material { %s }\n\t}\n", pov_mat);
 		    break;
 		}
 		case ID_HRT:
-		{
-		    struct rt_hrt_internal *hrt = (struct rt_hrt_internal *)ip->idb_ptr;
-            Xdir = MAGNITUDE(hrt->xdir);
-            Ydir = MAGNITUDE(hrt->ydir);
-            Zdir = MAGNITUDE(hrt->zdir);
-		    printf("#include \"shapes.inc\"\nobject{\n\t\tSpheroid(\n");
-		    printf("\t<%g, %g, %g>,\n", V3ARGS(hrt->v));
-		    printf("< %g ,", Xdir);
-		    printf(" %g ,", Ydir);
-		    printf(" %g > )", Zdir);
-		    printf(" pigment{ LightBlue}\n\t}\n");
-
-
+		    pov_hrt(dp, (struct rt_hrt_internal *)ip->idb_ptr);
 		    break;
-		}
         case ID_ARB8:       /* convex primitive with from four to six faces */
 		{
 		    /* this primitive may have degenerate faces
@@ -373,17 +5462,16 @@ primitive_func(struct db_tree_state *tsp,
 		    struct rt_arb_internal *arb = (struct rt_arb_internal *)ip->idb_ptr;
 
 		    char coordinates[] = {'b','c','h','g','a','d','e','f'};
-		    printf("#declare Default_texture = pigment {rgb 0.8}\n");
 		    for(i=0; i<8; i++)
 		    {
-		    printf("#declare %c = <%g, %g, %g>;\n", coordinates[i], V3ARGS(arb->pt[i]));
+		    pov_printf("#declare %c = <%g, %g, %g>;\n", coordinates[i], V3ARGS(arb->pt[i]));
 		    }
-		    printf("#declare Box = mesh{\n");
-		    printf("triangle{a,b,c}\ntriangle{a,c,d}\ntriangle{a,d,f}\n");
-		    printf("triangle{e,d,f}\ntriangle{c,d,e}\ntriangle{c,e,h}\n");
-		    printf("triangle{a,b,g}\ntriangle{a,f,g}\ntriangle{b,c,g}\n");
-		    printf("triangle{g,h,c}\ntriangle{e,f,g}\ntriangle{e,g,h}\n");
-		    printf("texture{Default_texture}\n}\n Box\n");
+		    pov_printf("#declare Box = mesh{\n");
+		    pov_printf("triangle{a,b,c}\ntriangle{a,c,d}\ntriangle{a,d,f}\n");
+		    pov_printf("triangle{e,d,f}\ntriangle{c,d,e}\ntriangle{c,e,h}\n");
+		    pov_printf("triangle{a,b,g}\ntriangle{a,f,g}\ntriangle{b,c,g}\n");
+		    pov_printf("triangle{g,h,c}\ntriangle{e,f,g}\ntriangle{e,g,h}\n");
+		    pov_printf("}\nobject { Box material { %s } }\n", pov_mat);
 			break;
 		}
 
@@ -391,153 +5479,149 @@ primitive_func(struct db_tree_state *tsp,
 		{
 			struct rt_bot_internal *bot = (struct rt_bot_internal *)ip->idb_ptr;
 			for (j = 0; j < bot->num_vertices; j++)
-                printf("#declare t%lu = <%g, %g, %g>;\n",j, V3ARGS(&bot->vertices[j*3]));
-	        printf("union{\n");
+                pov_printf("#declare t%lu = <%g, %g, %g>;\n",j, V3ARGS(&bot->vertices[j*3]));
+	        pov_printf("union{\n");
             for (j = 0; j < bot->num_faces; j++)
-                printf("triangle{ t%d, t%d, t%d}\n", V3ARGS(&bot->faces[j*3]));
-            printf("pigment { \ncolor LightBlue }\n}");
+                pov_printf("triangle{ t%d, t%d, t%d}\n", V3ARGS(&bot->faces[j*3]));
+            pov_printf("material { %s }\n}\n", pov_mat);
+            pov_verts += bot->num_vertices;
+            pov_faces += bot->num_faces;
         	break;
 		}
 		case ID_ARS:
 		    /* series of curves
 		    * each with the same number of points
 		    */
+		    pov_ars(dp, (struct rt_ars_internal *)ip->idb_ptr, tsp->ts_tol);
+		    break;
+
 		case ID_HALF:   /* half universe defined by a plane */
 		{
 		    /* spheres*/
 		    struct rt_half_internal *half = (struct rt_half_internal *)ip->idb_ptr;
-		    printf("plane{\n");
-		    printf("\t<%g, %g, %g>,\n", V3ARGS(half->eqn));
-		    printf("\t %g}", half->eqn[3]);
+		    pov_printf("plane{\n");
+		    pov_printf("\t<%g, %g, %g>,\n", V3ARGS(half->eqn));
+		    pov_printf("\t %g\n", half->eqn[3]);
+		    pov_printf("\tmaterial { %s }\n}\n", pov_mat);
 		    break;
 		}
 		case ID_POLY:
 		    /* polygons (up to 5 vertices per) */
-		case ID_BSPLINE:
-		   /* NURB surfaces */
-		case ID_NMG:
-		   /* N-manifold geometry */
+		    pov_pg(dp, (struct rt_pg_internal *)ip->idb_ptr);
+		    break;
+
 		case ID_ARBN:
 		{
 			struct rt_arbn_internal *arbn= (struct rt_arbn_internal *)ip->idb_ptr;
-			printf("intersection{\n");
+			pov_printf("intersection{\n");
 			for (j = 0; j < arbn->neqn; j++) {
-            printf("plane{ <%g, %g, %g>, %g\n pigment {\n color LightBlue}}\n",
+            pov_printf("plane{ <%g, %g, %g>, %g }\n",
                     arbn->eqn[j][X], arbn->eqn[j][Y],
                     arbn->eqn[j][Z], arbn->eqn[j][3]);
 	        }
-	        printf("}\n");
+	        pov_printf("material { %s }\n}\n", pov_mat);
 			break;
 		}
 
+		case ID_BSPLINE:
+		   /* NURB surfaces */
+		    pov_bspline(dp, (struct rt_nurb_internal *)ip->idb_ptr, &your_stuff->ttol, your_stuff->ncpu);
+		    break;
+
+		case ID_NMG:
+		   /* N-manifold geometry */
+		    pov_nmg(dp, (struct model *)ip->idb_ptr, your_stuff->ncpu);
+		    break;
+
 		case ID_DSP:
 		   /* Displacement map (terrain primitive) */
 		   /* the DSP primitive may reference an external file or binunif object */
+		    pov_dsp(dp, (struct rt_dsp_internal *)ip->idb_ptr);
+		    break;
 		case ID_HF:
 		   /* height field (terrain primitive) */
 		   /* the HF primitive references an external file */
+		    pov_hf(dp, (struct rt_hf_internal *)ip->idb_ptr);
+		    break;
 		case ID_EBM:
 		   /* extruded bit-map */
 		   /* the EBM primitive references an external file */
+		    pov_ebm(dp, (struct rt_ebm_internal *)ip->idb_ptr, your_stuff->ncpu);
+		    break;
 		case ID_VOL:
 		   /* the VOL primitive references an external file */
+		    pov_vol(dp, (struct rt_vol_internal *)ip->idb_ptr, your_stuff->ncpu);
+		    break;
 		case ID_PIPE:
 		{
 			/*struct rt_pipe_internal *pipe= (struct rt_pipe_internal *)ip->idb_ptr;
-			printf("%g\n", &pint->pipe_segs_head );
-			printf("%g\n", pip->pp_od);
-			printf("%g\n", pip->pp_id);
-			printf("%g\n", pipept->pp_bendradius );
-			printf("\t<%g, %g, %g>,\n", V3ARGS(p1));*/
+			pov_printf("%g\n", &pint->pipe_segs_head );
+			pov_printf("%g\n", pip->pp_od);
+			pov_printf("%g\n", pip->pp_id);
+			pov_printf("%g\n", pipept->pp_bendradius );
+			pov_printf("\t<%g, %g, %g>,\n", V3ARGS(p1));*/
 
 		}
 		case ID_PARTICLE:
 		{
 		    struct rt_part_internal *part = (struct rt_part_internal *)ip->idb_ptr;
-		    printf("#include \"shapes.inc\"\n");
-		    printf("object{\n\t Round_Cone2(\n");
-		    printf("\t\t<%g %g %g>,", V3ARGS(part->part_V) );
-		    printf(" %g,\n", part->part_vrad );
-		    printf("\t\t <%g %g %g>,", V3ARGS(part->part_H) );
-		    printf(" %g, 0)\n", part->part_hrad );
-		    printf("pigment{ LightBlue}\n}");
+		    pov_printf("#include \"shapes.inc\"\n");
+		    pov_printf("object{\n\t Round_Cone2(\n");
+		    pov_printf("\t\t<%g %g %g>,", V3ARGS(part->part_V) );
+		    pov_printf(" %g,\n", part->part_vrad );
+		    pov_printf("\t\t <%g %g %g>,", V3ARGS(part->part_H) );
+		    pov_printf(" %g, 0)\n", part->part_hrad );
+		    pov_printf("material { %s }\n}\n", pov_mat);
 		    break;
 		}
 		case ID_RPC:
-		{
-			struct rt_rpc_internal *rpc = (struct rt_rpc_internal *)ip->idb_ptr;
-			printf("isosurface {\nfunction { pow(x,2) + y }\n");
-			printf("translate<%g, %g, %g>", V3ARGS(rpc->rpc_V));
-			break;
-		}
+		    pov_rpc(dp, (struct rt_rpc_internal *)ip->idb_ptr);
+		    break;
 		case ID_RHC:
-		{
-			struct rt_rhc_internal *rhc = (struct rt_rhc_internal *)ip->idb_ptr;
-			printf("isosurface {\nfunction { pow(x,2) + y }\n");
-			printf("translate<%g, %g, %g>", V3ARGS(rhc->rhc_V));
-			break;
-		}
+		    pov_rhc(dp, (struct rt_rhc_internal *)ip->idb_ptr);
+		    break;
 		case ID_EPA:
-		{
-			struct rt_epa_internal *epa = (struct rt_epa_internal *)ip->idb_ptr;
-			maga = MAGNITUDE(epa->epa_H);
-			printf("quadric { < 1, 0, 1> , <0, 0, 0>, < 0, -1 , 0>, 0 \n");
-			printf("translate <%g, %g, %g>", V3ARGS(epa->epa_V));
-			printf("clipped_by{ plane{<%g, %g, %g>,", V3ARGS(epa->epa_H));
-			printf("%g }} \n",maga );
-			printf("pigment { \ncolor LightBlue}\n}\n");
-
-			break;
-		}
+		    pov_epa(dp, (struct rt_epa_internal *)ip->idb_ptr);
+		    break;
 		case ID_EHY:
-		{
-			struct rt_ehy_internal *ehy = (struct rt_ehy_internal *)ip->idb_ptr;
-			maga = MAGNITUDE(ehy->ehy_H);
-			printf("quadric { < 1, 0, 1> , <0, 0, 0>, < 0, -1 , 0>, 0 \n");
-			printf("translate <%g, %g, %g>\n", V3ARGS(ehy->ehy_V));
-			printf("clipped_by {plane{<%g, %g, %g>,  ", V3ARGS(ehy->ehy_H));
-			printf("%g }} \n",maga );
-			printf("pigment { \ncolor LightBlue}\n}\n");
-
-			break;
-		}
+		    pov_ehy(dp, (struct rt_ehy_internal *)ip->idb_ptr);
+		    break;
+		case ID_HYP:
+		    pov_hyp(dp, (struct rt_hyp_internal *)ip->idb_ptr);
+		    break;
 		case ID_ETO:
-		{
-			struct rt_eto_internal *eto = (struct rt_eto_internal *)ip->idb_ptr;
-		    if ( flag == 0 )
-		    {
-		    printf("#include \"functions.inc\"\n");
-		    printf("isosurface {function { f_torus(x,y,z,1*(y+0.4),0.1 )}");
-		    printf("max_gradient 2\ntranslate<0, 0, 0>\npigment {rgb .9}");
-        	printf("finish {phong 0.5 phong_size 10}}");
-		    flag = 1;
-		    }
-		    printf(" \nobject {\tTorus (\n");
-		    printf("\t< %g, %g, %g>, ", V3ARGS(eto->eto_V));
-		    printf("<%g, %g, %g>, ", V3ARGS(eto->eto_N));
-		    printf("<%g, %g, %g>, ", V3ARGS(eto->eto_C));
-		    printf(" %g , ", eto->eto_r);
-		    printf("%g )", eto->eto_rd);
-		    printf(" texture{ pigment{ LightBlue} }}\n");
-
-			break;
-		}
+		    pov_eto(dp, (struct rt_eto_internal *)ip->idb_ptr);
+		    break;
+		case ID_PNTS:
+		    pov_pnts(dp, (struct rt_pnts_internal *)ip->idb_ptr, your_stuff->pnts_group);
+		    break;
+		case ID_CLINE:
+		    pov_cline(dp, (struct rt_cline_internal *)ip->idb_ptr);
+		    break;
+		case ID_REVOLVE:
+		    pov_revolve(dp, (struct rt_revolve_internal *)ip->idb_ptr, tsp->ts_dbip, tsp->ts_tol);
+		    break;
+		case ID_SUPERELL:
+		    pov_superell(dp, (struct rt_superell_internal *)ip->idb_ptr);
+		    break;
+		case ID_METABALL:
+		    pov_metaball(dp, (struct rt_metaball_internal *)ip->idb_ptr);
+		    break;
 		case ID_GRIP:
 		case ID_SKETCH:
+		    /* no volume of their own */
+		    pov_log(POV_LOG_WARN, "g-pov: %s is not a solid, skipped\n", dp->d_namep);
+		    break;
 		case ID_EXTRUDE:
-		{
-			struct rt_extrude_internal *extr = (struct rt_extrude_internal *)ip->idb_ptr;
-			printf("%s ", extr->sketch_name);
-		    printf("%g, %g, %g", V3ARGS(extr->V));
-		    printf("%g, %g, %g ", V3ARGS(extr->h));
-		    printf("%g, %g, %g ", V3ARGS(extr->u_vec));
-		    printf("%g, %g, %g", V3ARGS(extr->v_vec));
+		    pov_extrude(dp, (struct rt_extrude_internal *)ip->idb_ptr, tsp->ts_dbip, tsp->ts_tol);
+		    break;
+		case ID_SUBMODEL:
+		    pov_submodel(dp, (struct rt_submodel_internal *)ip->idb_ptr, tsp, client_data);
 		    break;
-		}
 
 	    
 	    default:
-		bu_log("Primitive %s is an unsupported or unrecognized type (%d)\n", dp->d_namep, ip->idb_type);
+		pov_log(POV_LOG_WARN, "Primitive %s is an unsupported or unrecognized type (%d)\n", dp->d_namep, ip->idb_type);
 		break;
 	}
     } else {
@@ -550,34 +5634,288 @@ primitive_func(struct db_tree_state *tsp,
 		    struct rt_binunif_internal *bin = (struct rt_binunif_internal *)ip->idb_ptr;
 
 		    if (bin)
-			printf("Found a binary object (%s)\n\n", dp->d_namep);
+			pov_printf("Found a binary object (%s)\n\n", dp->d_namep);
 		    break;
 		}
 	    default:
-		bu_log("Major type of %s is unrecognized type (%d)\n", dp->d_namep, ip->idb_major_type);
+		pov_log(POV_LOG_WARN, "Major type of %s is unrecognized type (%d)\n", dp->d_namep, ip->idb_major_type);
 		break;
 	}
     }
 
+    mat_pending = NULL;
+    pov_stats_end(&frame, (ip->idb_major_type == DB5_MAJORTYPE_BRLCAD && ip->idb_type <= ID_MAXIMUM) ? ip->idb_type : -1);
+    pov_trace_end(dp->d_namep, (ip->idb_major_type == DB5_MAJORTYPE_BRLCAD && ip->idb_type <= ID_MAXIMUM)
+		  ? pov_stats_label(ip->idb_type) : "binary", 0, frame.start);
+    alloc_phase = outer_phase;
     return (union tree *) NULL;
 }
 
 
+#ifndef POV_EMITTERS_ONLY
+/**
+ * @brief Read a 32-bit length or type from a capture, advancing cp.
+ * Returns -1 when the capture ends first.
+ */
+static int
+pov_replay_long(const unsigned char **cp, const unsigned char *end, size_t *val)
+{
+    if (end - *cp < 4)
+	return -1;
+    *val = bu_glong(*cp);
+    *cp += 4;
+    return 0;
+}
+
+
+static int
+pov_replay_string(const unsigned char **cp, const unsigned char *end, struct bu_vls *str)
+{
+    size_t len;
+
+    if (pov_replay_long(cp, end, &len) < 0 || (size_t)(end - *cp) < len)
+	return -1;
+    bu_vls_trunc(str, 0);
+    bu_vls_strncat(str, (const char *)*cp, len);
+    *cp += len;
+    return 0;
+}
+
+
+/* a captured callback, decoded and ready to replay */
+struct pov_replay_call {
+    int kind;		/* 'R' for region_start, else primitive_func */
+    struct db_full_path path;
+    struct rt_db_internal intern;
+    double d[POV_CAPTURE_DOUBLES];	/* ts_mat and ma_color */
+    int color_valid;
+    char *shader;	/* NULL for none */
+};
+
+/* a --record capture, decoded by pov_replay_load() */
+struct pov_replay_set {
+    struct db_i *dbip;	/* in memory, holds the recorded names */
+    struct bu_ptbl calls;	/* struct pov_replay_call */
+};
+
+
+/**
+ * @brief Read a --record capture whole and decode every callback in
+ * it, so that pov_replay() does no reading or importing of its own.
+ * The paths are entered into an in-memory database so the callbacks
+ * see the names they were recorded with.  Returns -1 when the capture
+ * is unusable or truncated; what was decoded before the truncation is
+ * kept.
+ */
+static int
+pov_replay_load(const char *file, struct pov_replay_set *rp)
+{
+    struct bu_vls path = BU_VLS_INIT_ZERO;
+    struct bu_vls shader = BU_VLS_INIT_ZERO;
+    unsigned char *data;
+    const unsigned char *cp, *end;
+    size_t size;
+    FILE *fp;
+    int ret = 0;
+
+    rp->dbip = DBI_NULL;
+    bu_ptbl_init(&rp->calls, 1024, "replay calls");
+
+    if ((fp = fopen(file, "rb")) == NULL) {
+	perror(file);
+	pov_log(POV_LOG_WARN, "g-pov: unable to read the capture %s\n", file);
+	return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = (size_t)ftell(fp);
+    rewind(fp);
+    data = (unsigned char *)bu_malloc(size + 1, "capture");
+    if (fread(data, 1, size, fp) != size || size < POV_CAPTURE_MAGIC_LEN
+	|| memcmp(data, POV_CAPTURE_MAGIC, POV_CAPTURE_MAGIC_LEN)) {
+	pov_log(POV_LOG_WARN, "g-pov: %s is not a g-pov capture\n", file);
+	fclose(fp);
+	bu_free(data, "capture");
+	return -1;
+    }
+    fclose(fp);
+
+    if ((rp->dbip = db_open_inmem()) == DBI_NULL) {
+	bu_free(data, "capture");
+	return -1;
+    }
+
+    cp = data + POV_CAPTURE_MAGIC_LEN;
+    end = data + size;
+    while (cp < end) {
+	struct pov_replay_call *callp;
+	struct bu_external ext;
+	double d[POV_CAPTURE_DOUBLES];
+	size_t major, len;
+	char *name, *next;
+	int kind, color_valid;
+
+	kind = *cp++;
+	if (pov_replay_string(&cp, end, &path) < 0
+	    || (size_t)(end - cp) < POV_CAPTURE_DOUBLES * 8 + 1)
+	    break;
+	ntohd((unsigned char *)d, cp, POV_CAPTURE_DOUBLES);
+	cp += POV_CAPTURE_DOUBLES * 8;
+	color_valid = *cp++;
+	if (pov_replay_string(&cp, end, &shader) < 0
+	    || pov_replay_long(&cp, end, &major) < 0
+	    || pov_replay_long(&cp, end, &len) < 0
+	    || (size_t)(end - cp) < len)
+	    break;
+
+	BU_EXTERNAL_INIT(&ext);
+	ext.ext_buf = (uint8_t *)cp;
+	ext.ext_nbytes = len;
+	cp += len;
+
+	/* every name on the path has to be in the directory */
+	for (name = bu_vls_addr(&path); *name; name = next) {
+	    while (*name == '/')
+		name++;
+	    if (!*name)
+		break;
+	    for (next = name; *next && *next != '/'; next++)
+		;
+	    if (*next) {
+		*next = '\0';
+		if (db_lookup(rp->dbip, name, LOOKUP_QUIET) == RT_DIR_NULL)
+		    db_diradd(rp->dbip, name, RT_DIR_PHONY_ADDR, 0, RT_DIR_COMB, NULL);
+		*next++ = '/';
+	    } else if (db_lookup(rp->dbip, name, LOOKUP_QUIET) == RT_DIR_NULL) {
+		db_diradd(rp->dbip, name, RT_DIR_PHONY_ADDR, 0, kind == 'R' ? RT_DIR_COMB : RT_DIR_SOLID, NULL);
+	    }
+	}
+
+	BU_ALLOC(callp, struct pov_replay_call);
+	db_full_path_init(&callp->path);
+	if (db_string_to_path(&callp->path, rp->dbip, bu_vls_addr(&path)) < 0) {
+	    pov_log(POV_LOG_WARN, "g-pov: unable to replay %s, skipped\n", bu_vls_addr(&path));
+	    db_free_full_path(&callp->path);
+	    bu_free(callp, "pov_replay_call");
+	    continue;
+	}
+
+	RT_DB_INTERNAL_INIT(&callp->intern);
+	if (rt_db_external5_to_internal5(&callp->intern, &ext, DB_FULL_PATH_CUR_DIR(&callp->path)->d_namep,
+					 rp->dbip, bn_mat_identity, &rt_uniresource) < 0) {
+	    pov_log(POV_LOG_WARN, "g-pov: unable to replay %s, skipped\n", bu_vls_addr(&path));
+	    db_free_full_path(&callp->path);
+	    bu_free(callp, "pov_replay_call");
+	    continue;
+	}
+
+	callp->kind = kind;
+	memcpy(callp->d, d, sizeof(d));
+	callp->color_valid = color_valid;
+	callp->shader = bu_vls_strlen(&shader) ? bu_strdup(bu_vls_addr(&shader)) : NULL;
+	bu_ptbl_ins(&rp->calls, (long *)callp);
+    }
+    if (cp < end) {
+	pov_log(POV_LOG_WARN, "g-pov: capture %s is truncated after %lu callbacks\n", file,
+		(unsigned long)BU_PTBL_LEN(&rp->calls));
+	ret = -1;
+    }
+
+    bu_vls_free(&path);
+    bu_vls_free(&shader);
+    bu_free(data, "capture");
+    return ret;
+}
+
+
+/**
+ * @brief Feed a capture decoded by pov_replay_load() to region_start()
+ * and primitive_func() as db_walk_tree() would have, with no database
+ * file or tree walk, then free it.
+ */
+static void
+pov_replay(struct pov_replay_set *rp, const struct db_tree_state *init_state, struct user_data *ud)
+{
+    size_t n;
+    int i;
+
+    for (n = 0; n < BU_PTBL_LEN(&rp->calls); n++) {
+	struct pov_replay_call *callp = (struct pov_replay_call *)BU_PTBL_GET(&rp->calls, n);
+	struct db_tree_state state;
+
+	state = *init_state;
+	state.ts_dbip = rp->dbip;
+	state.ts_resp = &rt_uniresource;
+	for (i = 0; i < 16; i++)
+	    state.ts_mat[i] = callp->d[i];
+	for (i = 0; i < 3; i++)
+	    state.ts_mater.ma_color[i] = callp->d[16 + i];
+	state.ts_mater.ma_color_valid = callp->color_valid;
+	state.ts_mater.ma_shader = callp->shader;
+
+	if (callp->kind == 'R')
+	    (void)region_start(&state, &callp->path, (struct rt_comb_internal *)callp->intern.idb_ptr, ud);
+	else
+	    (void)primitive_func(&state, &callp->path, &callp->intern, ud);
+    }
+    pov_trace_region(NULL);
+}
+
+
+/**
+ * @brief Free a capture decoded by pov_replay_load().
+ */
+static void
+pov_replay_free(struct pov_replay_set *rp)
+{
+    size_t n;
+
+    for (n = 0; n < BU_PTBL_LEN(&rp->calls); n++) {
+	struct pov_replay_call *callp = (struct pov_replay_call *)BU_PTBL_GET(&rp->calls, n);
+
+	rt_db_free_internal(&callp->intern);
+	db_free_full_path(&callp->path);
+	if (callp->shader)
+	    bu_free(callp->shader, "replay shader");
+	bu_free(callp, "pov_replay_call");
+    }
+    bu_ptbl_free(&rp->calls);
+    if (rp->dbip != DBI_NULL)
+	db_close(rp->dbip);
+}
+
+
 int
 main(int argc, char *argv[])
 {
-    static const char usage[] = "Usage: %s [-xX lvl] [-a abs_tol] [-r rel_tol] [-n norm_tol] [-o out_file] [-C Camera_loc] [-V Look_at] [-L Light_loc] [-l Light_col] [-D default] brlcad_db.g object(s)\n";
+    static const char usage[] = "Usage: %s [-xX lvl] [-a abs_tol] [-r rel_tol] [-n norm_tol] [-o out_file] [-P ncpu] [-G pnts_per_group] [-C Camera_loc] [-V Look_at] [-L Light_loc] [-l Light_col] [-D default] [-v] [--stats-json file] [--trace file] [--record file] [--counters] [--allocs] brlcad_db.g object(s)\n       %s [options] --replay file\n";
 
-    struct user_data your_data = {0, BN_TOL_INIT_ZERO};
+    struct user_data your_data = {0, BN_TOL_INIT_ZERO, RT_TESS_TOL_INIT_ZERO, 1, 0};
     int i;
     int c;
+    int default_view = 0;
     char idbuf[132] = {0};
+    int64_t start;
+    struct pov_counters ctr;
 
     struct rt_i *rtip;
     struct db_tree_state init_state;
 
     bu_setprogname(argv[0]);
     bu_setlinebuf(stderr);
+    bu_bomb_add_hook(pov_log_bomb, NULL);
+    atexit(pov_log_exit);	/* bu_exit() */
+
+    if (pov_long_opts(&argc, argv) < 0)
+	bu_exit(1, usage, argv[0], argv[0]);
+    trace_epoch = bu_gettime();
+    if (counters_enabled)
+	pov_counters_open();
+#ifndef POV_ALLOC_HOOKS
+    if (allocs_enabled) {
+	bu_log("g-pov: built without POV_ALLOC_PROFILE, --allocs ignored\n");
+	allocs_enabled = 0;
+    }
+#endif
 
     /* calculational tolerances
      * mostly used by NMG routines
@@ -587,17 +5925,43 @@ main(int argc, char *argv[])
     your_data.tol.dist_sq = your_data.tol.dist * your_data.tol.dist;
     your_data.tol.perp = 1e-6;
     your_data.tol.para = 1 - your_data.tol.perp;
-    
+
+    /* tessellation tolerances, used where surfaces are faceted */
+    your_data.ttol.magic = RT_TESS_TOL_MAGIC;
+    your_data.ttol.abs = 0.0;
+    your_data.ttol.rel = 0.01;
+    your_data.ttol.norm = 0.0;
 
     /* Get command line arguments. */
-    while ((c = bu_getopt(argc, argv, "t:a:n:o:r:x:X:C:V:L:l:c:D")) != -1) {
+    while ((c = bu_getopt(argc, argv, "t:a:n:o:r:x:X:C:V:L:l:c:DP:G:v")) != -1) {
 	float a1, a2, a3, a4, b1, b2, b3, b4,  c2, c3, c4;
 	switch (c) {
 	    case 't':		/* calculational tolerance */
 		your_data.tol.dist = atof(bu_optarg);
 		your_data.tol.dist_sq = your_data.tol.dist * your_data.tol.dist;
+		break;
+	    case 'a':		/* Absolute tolerance. */
+		your_data.ttol.abs = atof(bu_optarg);
+		your_data.ttol.rel = 0.0;
+		break;
+	    case 'r':		/* Relative tolerance. */
+		your_data.ttol.rel = atof(bu_optarg);
+		break;
+	    case 'n':		/* Surface normal tolerance. */
+		your_data.ttol.norm = atof(bu_optarg);
+		break;
 	    case 'o':		/* Output file name */
-		/* grab output file name */
+		out_file = bu_optarg;
+		break;
+	    case 'P':		/* number of CPUs for parallel emitters */
+		your_data.ncpu = atoi(bu_optarg);
+		if (your_data.ncpu < 1)
+		    your_data.ncpu = 1;
+		if (your_data.ncpu > MAX_PSW)
+		    your_data.ncpu = MAX_PSW;
+		break;
+	    case 'G':		/* point cloud group size */
+		your_data.pnts_group = (size_t)atol(bu_optarg);
 		break;
 	    case 'x':		/* librt debug flag */
 		sscanf(bu_optarg, "%x", &RTG.debug);
@@ -612,69 +5976,164 @@ main(int argc, char *argv[])
 	    case 'C':
 		if(sscanf(bu_optarg, "%g, %g", &a1, &b1))
 		{
-			printf("the value of a b c %g, %g ", a1, b1);
+			pov_printf("the value of a b c %g, %g ", a1, b1);
 			bu_log("\n");
 		}
 		else
 		{
-		        bu_exit(1, usage, argv[0]);
+		        bu_exit(1, usage, argv[0], argv[0]);
 		}
 		break;
 	    case 'V':
 		sscanf(bu_optarg, "%g %g %g", &a2, &b2, &c2);
-		printf("Camera View point ");
+		pov_printf("Camera View point ");
 		bu_log("\n");
 		break;
 	    case 'L':
 		sscanf(bu_optarg, "%g %g %g", &a3, &b3, &c3);
-		printf("Light");
+		pov_printf("Light");
 		bu_log("\n");
 		break;
 	    case 'l':
 		sscanf(bu_optarg, "%g %g %g", &a4, &b4, &c4);
-		printf("Light colour");
+		pov_printf("Light colour");
 		bu_log("\n");
 		break;
 	    case 'D':
-		
-		printf("\n#include\"colors.inc\"\n");
-		printf("\nbackground { color Black }\n");
-		printf("camera\n\t{\n\t\tlocation <0, 0, 40>\n\t\tlook_at <0, 0, 0>\n\t\t\t}\n");
-		printf("light_source\n\t{\n\t\t<0, 0, 40> White\n\t\t}\n");
-		bu_log("\n");
+		default_view = 1;
+		break;
+	    case 'v':		/* more messages each time */
+		if (pov_log_level < POV_LOG_DEBUG)
+		    pov_log_level++;
 		break;
 	    default:
-		bu_exit(1, usage, argv[0]);
+		bu_exit(1, usage, argv[0], argv[0]);
 		break;
 	}
     }
-    if (bu_optind+1 >= argc) {
-	bu_exit(1, usage, argv[0]);
+    if (!replay_file && bu_optind+1 >= argc) {
+	bu_exit(1, usage, argv[0], argv[0]);
+    }
+
+    /* sidecar data files are named after the output file */
+    if (out_file && freopen(out_file, "w", stdout) == NULL) {
+	perror(out_file);
+	bu_exit(1, "g-pov: unable to open %s for writing\n", out_file);
     }
+    if (counter_fds[0] >= 0)
+	setvbuf(stdout, scene_buf, _IOFBF, sizeof(scene_buf));
 
-    /* Open BRL-CAD database */
-    /* Scan all the records in the database and build a directory */
-    rtip=rt_dirbuild(argv[bu_optind], idbuf, sizeof(idbuf));
-    if (rtip == RTI_NULL) {
-	bu_exit(1, "g-xxx: rt_dirbuild failure\n");
+    if (default_view) {
+	pov_printf("\n#include\"colors.inc\"\n");
+	pov_printf("\nbackground { color Black }\n");
+	pov_printf("camera\n\t{\n\t\tlocation <0, 0, 40>\n\t\tlook_at <0, 0, 0>\n\t\t\t}\n");
+	pov_printf("light_source\n\t{\n\t\t<0, 0, 40> White\n\t\t}\n");
     }
 
     init_state = rt_initial_tree_state;
+    init_state.ts_tol = &your_data.tol;
+    init_state.ts_ttol = &your_data.ttol;
+    bu_ptbl_init(&sidecars, 8, "sidecars");
+    bu_ptbl_init(&submodels, 8, "submodels");
 
-    bu_optind++;
+    if (replay_file) {
+	struct pov_replay_set replay;
 
-    /* Walk the trees named on the command line
-     * outputting combinations and primitives
-     */
-    for (i=bu_optind; i<argc; i++) {
+	/* the callbacks alone, no database; the capture is decoded first */
+	start = pov_trace_begin();
+	i = pov_replay_load(replay_file, &replay);
+	pov_log_flush();
+	if (i < 0 && !BU_PTBL_LEN(&replay.calls))
+	    bu_exit(1, "g-pov: unable to replay %s\n", replay_file);
+	pov_trace_end(replay_file, "decode", 0, start);
+
+	start = pov_trace_begin();
+	pov_counters_read(&ctr);
+	alloc_phase = POV_ALLOC_WALK;
+	pov_replay(&replay, &init_state, &your_data);
+	pov_log_flush();
+	alloc_phase = POV_ALLOC_OTHER;
+	pov_counters_add(&phases[POV_PHASE_WALK], &ctr);
+	pov_trace_end(replay_file, "replay", 0, start);
+	pov_replay_free(&replay);
+    } else {
+	if (record_file) {
+	    if ((capture = fopen(record_file, "wb")) == NULL) {
+		perror(record_file);
+		bu_exit(1, "g-pov: unable to open %s for writing\n", record_file);
+	    }
+	    fwrite(POV_CAPTURE_MAGIC, POV_CAPTURE_MAGIC_LEN, 1, capture);
+	}
+
+	/* Open BRL-CAD database */
+	/* Scan all the records in the database and build a directory */
+	start = pov_trace_begin();
+	pov_counters_read(&ctr);
+	alloc_phase = POV_ALLOC_DIRBUILD;
+	rtip=rt_dirbuild(argv[bu_optind], idbuf, sizeof(idbuf));
+	if (rtip == RTI_NULL) {
+	    bu_exit(1, "g-xxx: rt_dirbuild failure\n");
+	}
+	alloc_phase = POV_ALLOC_OTHER;
+	pov_counters_add(&phases[POV_PHASE_DIRBUILD], &ctr);
+	pov_trace_end(argv[bu_optind], "rt_dirbuild", 0, start);
+
+	bu_optind++;
 
-	
-	db_walk_tree(rtip->rti_dbip, argc - i, (const char **)&argv[i], 1 /* bu_avail_cpus() */,
-		     &init_state, region_start, region_end, primitive_func, (void *) &your_data);
+	/* Walk the trees named on the command line
+	 * outputting combinations and primitives
+	 */
+	for (i=bu_optind; i<argc; i++) {
+	    start = pov_trace_begin();
+	    pov_counters_read(&ctr);
+	    alloc_phase = POV_ALLOC_WALK;
+	    db_walk_tree(rtip->rti_dbip, 1, (const char **)&argv[i], 1 /* bu_avail_cpus() */,
+			 &init_state, region_start, region_end, primitive_func, (void *) &your_data);
+	    alloc_phase = POV_ALLOC_OTHER;
+	    pov_counters_add(&phases[POV_PHASE_WALK], &ctr);
+	    pov_trace_region(NULL);
+	    pov_trace_end(argv[i], "db_walk_tree", 0, start);
+	    pov_log_flush();
+	}
+
+	if (capture)
+	    fclose(capture);
+    }
+    pov_cline_flush();
+    bu_vls_free(&cline_batch);
+
+    for (i = 0; i < (int)BU_PTBL_LEN(&sidecars); i++) {
+	struct pov_sidecar *scp = (struct pov_sidecar *)BU_PTBL_GET(&sidecars, i);
+	bu_vls_free(&scp->path);
+	bu_free(scp, "pov_sidecar");
     }
+    bu_ptbl_free(&sidecars);
+    for (i = 0; i < (int)BU_PTBL_LEN(&submodels); i++) {
+	struct pov_submodel *smp = (struct pov_submodel *)BU_PTBL_GET(&submodels, i);
+	if (smp->dbip)
+	    db_close(smp->dbip);
+	bu_vls_free(&smp->file);
+	bu_vls_free(&smp->treetop);
+	bu_free(smp, "pov_submodel");
+    }
+    bu_ptbl_free(&submodels);
+    pov_material_free();
+    pov_scratch_free();
+    pov_log_free();
+
+    start = pov_trace_begin();
+    pov_scene_flush();
+    pov_trace_end("stdout", "flush", 0, start);
+    pov_stats_report();
+    pov_counters_close();
+    pov_alloc_report();
+    pov_trace_write(your_data.ncpu);
 
     return 0;
 }
+#endif /* POV_EMITTERS_ONLY */
+
+
 /*
  * Local Variables:
  * mode: C
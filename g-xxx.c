@@ -46,6 +46,17 @@
 struct user_data {
     long int data;
     struct bn_tol tol;
+    int dry_run;		/* --dry-run: walk and import, write nothing */
+    size_t regions;
+    size_t leaves;
+    int64_t emit;		/* microseconds spent in the callbacks */
+    struct bu_ptbl dry_leaves;	/* struct dry_leaf, for timing the imports */
+};
+
+/* a primitive reached by the walk, as it was instanced */
+struct dry_leaf {
+    const struct directory *dp;
+    mat_t mat;
 };
 
 /* This routine just produces an ascii description of the Boolean tree.
@@ -144,6 +155,7 @@ region_start(struct db_tree_state *tsp,
     struct directory *dp;
     struct bu_vls str = BU_VLS_INIT_ZERO;
     struct user_data *your_stuff = (struct user_data *)client_data;
+    int64_t start = bu_gettime();
 
     RT_CK_DBTS(tsp);
 
@@ -168,6 +180,8 @@ region_start(struct db_tree_state *tsp,
 
     bu_vls_free(&str);
 
+    your_stuff->regions++;
+    your_stuff->emit += bu_gettime() - start;
     return 0;
 }
 
@@ -218,11 +232,13 @@ union tree *
 primitive_func(struct db_tree_state *tsp,
 	       const struct db_full_path *pathp,
 	       struct rt_db_internal *ip,
-	       void *UNUSED(client_data))
+	       void *client_data)
 {
     int i;
     struct directory *dp;
     char *name;
+    struct user_data *your_stuff = (struct user_data *)client_data;
+    int64_t start = bu_gettime();
     dp = DB_FULL_PATH_CUR_DIR(pathp);
 
     RT_CK_DBTS(tsp);
@@ -435,19 +451,113 @@ primitive_func(struct db_tree_state *tsp,
 	}
     }
 
+    your_stuff->leaves++;
+    your_stuff->emit += bu_gettime() - start;
+    return (union tree *) NULL;
+}
+
+
+/**
+ * @brief Region callback of a --dry-run walk: count, write nothing.
+ */
+int
+dry_region_start(struct db_tree_state *tsp,
+		 const struct db_full_path *UNUSED(pathp),
+		 const struct rt_comb_internal *UNUSED(combp),
+		 void *client_data)
+{
+    RT_CK_DBTS(tsp);
+    ((struct user_data *)client_data)->regions++;
+    return 0;
+}
+
+
+/**
+ * @brief Region end callback of a --dry-run walk: hand the tree back,
+ * write nothing.
+ */
+union tree *
+dry_region_end(struct db_tree_state *UNUSED(tsp),
+	       const struct db_full_path *UNUSED(pathp),
+	       union tree *curtree,
+	       void *UNUSED(client_data))
+{
+    return curtree;
+}
+
+
+/**
+ * @brief Leaf callback of a --dry-run walk.  db_walk_tree has already
+ * imported the primitive; remember it so that the imports can be
+ * timed on their own afterwards.
+ */
+union tree *
+dry_primitive_func(struct db_tree_state *tsp,
+		   const struct db_full_path *pathp,
+		   struct rt_db_internal *UNUSED(ip),
+		   void *client_data)
+{
+    struct user_data *your_stuff = (struct user_data *)client_data;
+    struct dry_leaf *lp;
+
+    RT_CK_DBTS(tsp);
+
+    BU_ALLOC(lp, struct dry_leaf);
+    lp->dp = DB_FULL_PATH_CUR_DIR(pathp);
+    MAT_COPY(lp->mat, tsp->ts_mat);
+    bu_ptbl_ins(&your_stuff->dry_leaves, (long *)lp);
+    your_stuff->leaves++;
+
     return (union tree *) NULL;
 }
 
 
+/**
+ * @brief Import every primitive the dry run reached again, as the walk
+ * did, and return the microseconds taken.  The bytes read are added
+ * to *bytes.  The walk has just read the same objects, so this is the
+ * warm cache cost of an import, not what the walk itself paid.
+ */
+static int64_t
+dry_import(struct db_i *dbip, struct user_data *your_stuff, size_t *bytes)
+{
+    int64_t start = bu_gettime();
+    size_t i;
+
+    for (i = 0; i < BU_PTBL_LEN(&your_stuff->dry_leaves); i++) {
+	struct dry_leaf *lp = (struct dry_leaf *)BU_PTBL_GET(&your_stuff->dry_leaves, i);
+	struct rt_db_internal intern;
+
+	if (rt_db_get_internal(&intern, lp->dp, dbip, lp->mat, &rt_uniresource) < 0) {
+	    bu_log("g-xxx: unable to import %s\n", lp->dp->d_namep);
+	    continue;
+	}
+	*bytes += lp->dp->d_len;
+	rt_db_free_internal(&intern);
+    }
+
+    return bu_gettime() - start;
+}
+
+
+/* per second rate of n in us microseconds */
+static double
+per_sec(double n, int64_t us)
+{
+    return (us > 0) ? n * 1e6 / us : 0.0;
+}
+
+
 int
 main(int argc, char *argv[])
 {
-    static const char usage[] = "Usage: %s [-xX lvl] [-a abs_tol] [-r rel_tol] [-n norm_tol] [-o out_file] [-C Camera_loc] [-V Look_at] [-L Light_loc] [-l Light_col] [-D default] brlcad_db.g object(s)\n";
+    static const char usage[] = "Usage: %s [-xX lvl] [-a abs_tol] [-r rel_tol] [-n norm_tol] [-o out_file] [-C Camera_loc] [-V Look_at] [-L Light_loc] [-l Light_col] [-D default] [--dry-run] brlcad_db.g object(s)\n";
 
-    struct user_data your_data = {0, BN_TOL_INIT_ZERO};
-    int i;
+    struct user_data your_data = {0, BN_TOL_INIT_ZERO, 0, 0, 0, 0, BU_PTBL_INIT_ZERO};
+    int i, n;
     int c;
     char idbuf[132] = {0};
+    int64_t start, dirbuild, walk;
 
     struct rt_i *rtip;
     struct db_tree_state init_state;
@@ -463,7 +573,16 @@ main(int argc, char *argv[])
     your_data.tol.dist_sq = your_data.tol.dist * your_data.tol.dist;
     your_data.tol.perp = 1e-6;
     your_data.tol.para = 1 - your_data.tol.perp;
-    
+
+    /* --dry-run is taken out before bu_getopt() sees the arguments */
+    for (i = n = 1; i < argc; i++) {
+	if (BU_STR_EQUAL(argv[i], "--dry-run"))
+	    your_data.dry_run = 1;
+	else
+	    argv[n++] = argv[i];
+    }
+    argc = n;
+    argv[argc] = NULL;
 
     /* Get command line arguments. */
     while ((c = bu_getopt(argc, argv, "t:a:n:o:r:x:X:C:V:L:l:c:D")) != -1) {
@@ -531,10 +650,12 @@ main(int argc, char *argv[])
 
     /* Open BRL-CAD database */
     /* Scan all the records in the database and build a directory */
+    start = bu_gettime();
     rtip=rt_dirbuild(argv[bu_optind], idbuf, sizeof(idbuf));
     if (rtip == RTI_NULL) {
 	bu_exit(1, "g-xxx: rt_dirbuild failure\n");
     }
+    dirbuild = bu_gettime() - start;
 
     init_state = rt_initial_tree_state;
 
@@ -543,11 +664,41 @@ main(int argc, char *argv[])
     /* Walk the trees named on the command line
      * outputting combinations and primitives
      */
+    if (your_data.dry_run)
+	bu_ptbl_init(&your_data.dry_leaves, 1024, "dry leaves");
+    start = bu_gettime();
     for (i=bu_optind; i<argc; i++) {
+	if (your_data.dry_run)
+	    db_walk_tree(rtip->rti_dbip, 1, (const char **)&argv[i], 1 /* bu_avail_cpus() */,
+			 &init_state, dry_region_start, dry_region_end, dry_primitive_func, (void *) &your_data);
+	else
+	    db_walk_tree(rtip->rti_dbip, 1, (const char **)&argv[i], 1 /* bu_avail_cpus() */,
+			 &init_state, region_start, region_end, primitive_func, (void *) &your_data);
+    }
+    walk = bu_gettime() - start;
 
-	
-	db_walk_tree(rtip->rti_dbip, argc - i, (const char **)&argv[i], 1 /* bu_avail_cpus() */,
-		     &init_state, region_start, region_end, primitive_func, (void *) &your_data);
+    /* walk time covers traversal, import and the callbacks; a dry run
+     * has no emission, and times the imports again on their own, so
+     * its traversal time is an estimate
+     */
+    bu_log("g-xxx: rt_dirbuild %.3f s\n", dirbuild / 1e6);
+    bu_log("g-xxx: walked %lu regions, %lu primitives in %.3f s (%.1f primitives/s)\n",
+	   (unsigned long)your_data.regions, (unsigned long)your_data.leaves, walk / 1e6,
+	   per_sec(your_data.leaves, walk));
+    if (your_data.dry_run) {
+	size_t bytes = 0;
+	int64_t import = dry_import(rtip->rti_dbip, &your_data, &bytes);
+
+	bu_log("g-xxx: import %.3f s after the walk, warm (%.1f primitives/s, %.2f MB/s)\n", import / 1e6,
+	       per_sec(your_data.leaves, import), per_sec(bytes / 1048576.0, import));
+	bu_log("g-xxx: traversal about %.3f s, the walk less the warm import (%.1f regions/s)\n", (walk - import) / 1e6,
+	       per_sec(your_data.regions, walk - import));
+	for (i = 0; i < (int)BU_PTBL_LEN(&your_data.dry_leaves); i++)
+	    bu_free((void *)BU_PTBL_GET(&your_data.dry_leaves, i), "dry leaf");
+	bu_ptbl_free(&your_data.dry_leaves);
+    } else {
+	bu_log("g-xxx: emission %.3f s, traversal and import %.3f s\n",
+	       your_data.emit / 1e6, (walk - your_data.emit) / 1e6);
     }
 
     return 0;
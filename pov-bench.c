@@ -0,0 +1,641 @@
+/*                     P O V - B E N C H . C
+ * BRL-CAD
+ *
+ * Copyright (c) 1993-2014 United States Government as represented by
+ * the U.S. Army Research Laboratory.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this file; see the file named COPYING for more
+ * information.
+ *
+ */
+/** @file conv/pov-bench.c
+ * @brief Generate synthetic databases for benchmarking g-pov.
+ *
+ * Writes a database whose top level combination "all" holds N regions
+ * under a combination tree of the requested depth, optionally with a
+ * huge BOT, instanced assemblies placed by matrix and by submodel, and
+ * a mix of the primitive types g-pov converts.  pov-bench.sh runs
+ * g-pov over a suite of these.
+ *
+ * The mix leaves out halfspaces, which would swallow the scene, and
+ * the NMG, NURB, POLY and HF solids, which libwdb has no simple maker
+ * for.
+ *
+ */
+
+#include "common.h"
+
+/* system headers */
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "bio.h"
+
+/* interface headers */
+#include "vmath.h"
+#include "bu/getopt.h"
+#include "raytrace.h"
+#include "wdb.h"
+
+
+/* cell size of the grid the regions are laid out on */
+#define BENCH_CELL 10.0
+
+/* name of the assembly the -i and -S placements refer to */
+#define BENCH_ASSEMBLY "assembly.c"
+
+struct bench {
+    struct rt_wdb *fp;
+    const char *dbname;
+    size_t nregions;	/* -n */
+    int depth;		/* -d */
+    size_t botfaces;	/* -b */
+    size_t instances;	/* -i */
+    size_t submodels;	/* -S */
+    int mix;		/* -m */
+    size_t side;	/* grid side, in cells */
+};
+
+static const unsigned char palette[8][3] = {
+    {200, 40, 40}, {40, 200, 40}, {40, 40, 200}, {200, 200, 40},
+    {200, 40, 200}, {40, 200, 200}, {220, 220, 220}, {120, 120, 120}
+};
+static const char *shaders[4] = {"plastic", "plastic", "mirror", "glass"};
+
+
+/* center of grid cell k */
+static void
+bench_cell(const struct bench *bp, size_t k, point_t p)
+{
+    VSET(p, (k % bp->side) * BENCH_CELL,
+	 ((k / bp->side) % bp->side) * BENCH_CELL,
+	 (k / (bp->side * bp->side)) * BENCH_CELL);
+}
+
+
+/**
+ * @brief Make region rname holding the single solid sname, colored and
+ * shaded from a small palette so that materials repeat.
+ */
+static void
+bench_region(const struct bench *bp, const char *rname, const char *sname, size_t k)
+{
+    struct wmember head;
+
+    BU_LIST_INIT(&head.l);
+    (void)mk_addmember(sname, &head.l, NULL, WMOP_UNION);
+    mk_lcomb(bp->fp, rname, &head, 1, shaders[k % 4], "", palette[k % 8], 0);
+}
+
+
+/* write a file of n bytes made by fill(), for the primitives that read data files */
+static int
+bench_datafile(const char *path, size_t n, unsigned char (*fill)(size_t))
+{
+    FILE *fp;
+    size_t i;
+
+    if ((fp = fopen(path, "wb")) == NULL) {
+	perror(path);
+	return -1;
+    }
+    for (i = 0; i < n; i++)
+	putc(fill(i), fp);
+    fclose(fp);
+    return 0;
+}
+
+
+/* a disk in a 16x16 bitmap */
+static unsigned char
+bench_ebm_cell(size_t i)
+{
+    long x = (long)(i % 16) - 8, y = (long)(i / 16) - 8;
+    return (x * x + y * y < 49) ? 1 : 0;
+}
+
+
+/* a ball in a 12x12x12 volume */
+static unsigned char
+bench_vol_cell(size_t i)
+{
+    long x = (long)(i % 12) - 6, y = (long)((i / 12) % 12) - 6, z = (long)(i / 144) - 6;
+    return (x * x + y * y + z * z < 30) ? 255 : 0;
+}
+
+
+/* a 32x32 grid of bumps as big endian 16 bit elevations */
+static unsigned char
+bench_dsp_cell(size_t i)
+{
+    size_t cell = i / 2;
+    unsigned short h = (unsigned short)(1000.0 + 800.0 * sin((cell % 32) * 0.4) * cos((cell / 32) * 0.3));
+    return (i & 1) ? (unsigned char)(h & 0xff) : (unsigned char)(h >> 8);
+}
+
+
+/**
+ * @brief A unit square, or a triangle with edges along the axes, as a
+ * sketch of line segments in the sketch's plane.
+ */
+static int
+bench_sketch(struct rt_wdb *fp, const char *name, int nverts)
+{
+    struct rt_sketch_internal skt;
+    struct line_seg *lsg;
+    point2d_t verts[4] = {{0, 0}, {4, 0}, {4, 4}, {0, 4}};
+    int i, ret;
+
+    memset(&skt, 0, sizeof(skt));
+    skt.magic = RT_SKETCH_INTERNAL_MAGIC;
+    VSET(skt.u_vec, 1, 0, 0);
+    VSET(skt.v_vec, 0, 1, 0);
+    if (nverts == 3)
+	V2SET(verts[2], 0, 4);
+    skt.vert_count = nverts;
+    skt.verts = verts;
+    skt.curve.count = nverts;
+    skt.curve.reverse = (int *)bu_calloc(nverts, sizeof(int), "sketch reverse");
+    skt.curve.segment = (void **)bu_calloc(nverts, sizeof(void *), "sketch segments");
+    lsg = (struct line_seg *)bu_calloc(nverts, sizeof(struct line_seg), "sketch lines");
+    for (i = 0; i < nverts; i++) {
+	lsg[i].magic = CURVE_LSEG_MAGIC;
+	lsg[i].start = i;
+	lsg[i].end = (i + 1) % nverts;
+	skt.curve.segment[i] = (void *)&lsg[i];
+    }
+
+    ret = mk_sketch(fp, name, &skt);
+
+    bu_free(lsg, "sketch lines");
+    bu_free(skt.curve.segment, "sketch segments");
+    bu_free(skt.curve.reverse, "sketch reverse");
+    return ret;
+}
+
+
+/**
+ * @brief Make solid sname, of the kth kind in the mix, at p.  Returns
+ * 0, or -1 for a kind that could not be made.
+ */
+static int
+bench_solid(const struct bench *bp, const char *sname, size_t k, const point_t p)
+{
+    struct rt_wdb *fp = bp->fp;
+    vect_t a, b, c, h;
+    mat_t m;
+    char file[256];
+
+    switch (k % 24) {
+	case 0:
+	    return mk_sph(fp, sname, p, 3.0);
+	case 1:
+	    VSET(a, 4, 0, 0); VSET(b, 0, 3, 0); VSET(c, 0, 0, 2);
+	    return mk_ell(fp, sname, p, a, b, c);
+	case 2:
+	    VSET(h, 0, 0, 1);
+	    return mk_tor(fp, sname, p, h, 3.0, 1.0);
+	case 3:
+	    VSET(h, 0, 0, 6);
+	    return mk_rcc(fp, sname, p, h, 2.5);
+	case 4:
+	    VSET(h, 0, 0, 6);
+	    return mk_trc_h(fp, sname, p, h, 3.0, 1.0);
+	case 5: {
+	    fastf_t pts[24];
+	    int i;
+	    for (i = 0; i < 8; i++) {
+		pts[i*3+X] = p[X] + ((i == 1 || i == 2 || i == 5 || i == 6) ? 4 : 0);
+		pts[i*3+Y] = p[Y] + ((i == 2 || i == 3 || i == 6 || i == 7) ? 4 : 0);
+		pts[i*3+Z] = p[Z] + ((i >= 4) ? 4 : 0);
+	    }
+	    return mk_arb8(fp, sname, pts);
+	}
+	case 6: {
+	    /* an octahedron; mk_arbn() keeps the equations */
+	    plane_t *eqn = (plane_t *)bu_malloc(8 * sizeof(plane_t), "arbn eqn");
+	    int i;
+	    for (i = 0; i < 8; i++) {
+		VSET(eqn[i], (i & 1) ? 1 : -1, (i & 2) ? 1 : -1, (i & 4) ? 1 : -1);
+		VUNITIZE(eqn[i]);
+		eqn[i][W] = VDOT(eqn[i], p) + 3.0;
+	    }
+	    return mk_arbn(fp, sname, 8, (const plane_t *)eqn);
+	}
+	case 7:
+	    VSET(h, 0, 0, 6); VSET(b, 0, 1, 0);
+	    return mk_rpc(fp, sname, p, h, b, 2.0);
+	case 8:
+	    VSET(h, 0, 0, 6); VSET(b, 0, 1, 0);
+	    return mk_rhc(fp, sname, p, h, b, 2.0, 0.5);
+	case 9:
+	    VSET(h, 0, 0, 6); VSET(a, 1, 0, 0);
+	    return mk_epa(fp, sname, p, h, a, 3.0, 2.0);
+	case 10:
+	    VSET(h, 0, 0, 6); VSET(a, 1, 0, 0);
+	    return mk_ehy(fp, sname, p, h, a, 3.0, 2.0, 1.0);
+	case 11:
+	    VSET(h, 0, 0, 6); VSET(a, 3, 0, 0);
+	    return mk_hyp(fp, sname, p, h, a, 2.0, 0.5);
+	case 12:
+	    VSET(h, 0, 0, 1); VSET(c, 1, 0, 0);
+	    return mk_eto(fp, sname, p, h, c, 3.0, 0.5);
+	case 13:
+	    VSET(a, 3, 0, 0); VSET(b, 0, 3, 0); VSET(c, 0, 0, 3);
+	    return mk_hrt(fp, sname, p, a, b, c, 0.5);
+	case 14: {
+	    point_t v;
+	    VMOVE(v, p);
+	    VSET(h, 0, 0, 5);
+	    return mk_particle(fp, sname, v, h, 2.0, 1.0);
+	}
+	case 15: {
+	    /* a pinched cylinder, closed at both ends */
+	    fastf_t *curves[4];
+	    int i, j, ret;
+	    for (i = 0; i < 4; i++) {
+		curves[i] = (fastf_t *)bu_malloc(8 * 3 * sizeof(fastf_t), "ars curve");
+		for (j = 0; j < 8; j++) {
+		    fastf_t r = (i == 0 || i == 3) ? 0.0 : 3.0;
+		    VSET(&curves[i][j*3], p[X] + r * cos(j * M_PI / 4), p[Y] + r * sin(j * M_PI / 4), p[Z] + 2.0 * i);
+		}
+	    }
+	    ret = mk_ars(fp, sname, 4, 8, curves);
+	    for (i = 0; i < 4; i++)
+		bu_free(curves[i], "ars curve");
+	    return ret;
+	}
+	case 16: {
+	    fastf_t verts[12];
+	    int faces[12] = {0, 2, 1,  0, 1, 3,  1, 2, 3,  0, 3, 2};
+	    VSET(&verts[0], p[X], p[Y], p[Z]);
+	    VSET(&verts[3], p[X] + 4, p[Y], p[Z]);
+	    VSET(&verts[6], p[X], p[Y] + 4, p[Z]);
+	    VSET(&verts[9], p[X], p[Y], p[Z] + 4);
+	    return mk_bot(fp, sname, RT_BOT_SOLID, RT_BOT_CCW, 0, 4, 4, verts, faces, NULL, NULL);
+	}
+	case 17:
+	    VSET(h, 0, 0, 6);
+	    return mk_cline(fp, sname, p, h, 2.0, 0.5);
+	case 18: {
+	    fastf_t pts[2][5];
+	    const fastf_t *verts[5] = {NULL, NULL, NULL, NULL, NULL};
+	    VMOVE(pts[0], p); pts[0][3] = 1.0; pts[0][4] = 0.0;
+	    VSET(pts[1], p[X] + 3, p[Y], p[Z]); pts[1][3] = 1.0; pts[1][4] = 0.0;
+	    verts[0] = pts[0];
+	    verts[1] = pts[1];
+	    return mk_metaball(fp, sname, 2, 1, 1.0, verts);
+	}
+	case 19: {
+	    struct rt_superell_internal *sip;
+	    BU_ALLOC(sip, struct rt_superell_internal);
+	    sip->magic = RT_SUPERELL_INTERNAL_MAGIC;
+	    VMOVE(sip->v, p);
+	    VSET(sip->a, 3, 0, 0); VSET(sip->b, 0, 3, 0); VSET(sip->c, 0, 0, 3);
+	    sip->n = 0.5;
+	    sip->e = 2.0;
+	    return wdb_export(fp, sname, (void *)sip, ID_SUPERELL, mk_conv2mm);
+	}
+	case 20: {
+	    /* a small cloud; wdb_export() frees the list */
+	    struct rt_pnts_internal *pnts;
+	    struct pnt *head, *pt;
+	    int i;
+	    BU_ALLOC(pnts, struct rt_pnts_internal);
+	    BU_ALLOC(head, struct pnt);
+	    BU_LIST_INIT(&head->l);
+	    for (i = 0; i < 64; i++) {
+		BU_ALLOC(pt, struct pnt);
+		VSET(pt->v, p[X] + (i % 4), p[Y] + ((i / 4) % 4), p[Z] + (i / 16));
+		BU_LIST_PUSH(&head->l, &pt->l);
+	    }
+	    pnts->magic = RT_PNTS_INTERNAL_MAGIC;
+	    pnts->scale = 0.3;
+	    pnts->type = RT_PNT_TYPE_PNT;
+	    pnts->count = 64;
+	    pnts->point = (void *)head;
+	    return wdb_export(fp, sname, (void *)pnts, ID_PNTS, mk_conv2mm);
+	}
+	case 21:
+	    snprintf(file, sizeof(file), "%s.ebm", bp->dbname);
+	    MAT_IDN(m);
+	    MAT_DELTAS_VEC(m, p);
+	    return mk_ebm(fp, sname, file, 16, 16, 3.0, m);
+	case 22:
+	    snprintf(file, sizeof(file), "%s.vol", bp->dbname);
+	    MAT_IDN(m);
+	    MAT_DELTAS_VEC(m, p);
+	    VSET(c, 0.5, 0.5, 0.5);
+	    return mk_vol(fp, sname, file, 12, 12, 12, 128, 255, c, m);
+	case 23: {
+	    /* DSP cells are unit sized; scale the 32x32 grid to the cell */
+	    mat_t s, dsp;
+	    snprintf(file, sizeof(file), "%s.dsp", bp->dbname);
+	    MAT_IDN(s);
+	    s[0] = s[5] = 0.25;
+	    s[10] = 0.002;
+	    MAT_IDN(m);
+	    MAT_DELTAS_VEC(m, p);
+	    bn_mat_mul(dsp, m, s);
+	    return mk_dsp(fp, sname, file, 32, 32, dsp);
+	}
+    }
+    return -1;
+}
+
+
+/* sketch based kinds, which share the sketches made in main() */
+static int
+bench_sketch_solid(const struct bench *bp, const char *sname, size_t k, const point_t p)
+{
+    vect_t h, u, v;
+
+    if (k % 2 == 0) {
+	VSET(h, 0, 0, 5); VSET(u, 1, 0, 0); VSET(v, 0, 1, 0);
+	return mk_extrusion(bp->fp, sname, "square.sketch", p, h, u, v, 0);
+    } else {
+	struct rt_revolve_internal *rip;
+	BU_ALLOC(rip, struct rt_revolve_internal);
+	rip->magic = RT_REVOLVE_INTERNAL_MAGIC;
+	VMOVE(rip->v3d, p);
+	VSET(rip->axis3d, 0, 0, 1);
+	VSET(rip->r, 1, 0, 0);
+	rip->ang = M_2PI;
+	bu_vls_init(&rip->sketch_name);
+	bu_vls_strcpy(&rip->sketch_name, "triangle.sketch");
+	return wdb_export(bp->fp, sname, (void *)rip, ID_REVOLVE, mk_conv2mm);
+    }
+}
+
+
+/**
+ * @brief A closed UV sphere of about nfaces triangles, the stress
+ * case for mesh output.
+ */
+static void
+bench_bot(const struct bench *bp)
+{
+    size_t rings = (size_t)sqrt(bp->botfaces / 4.0) + 2;
+    size_t segs = 2 * rings;
+    size_t nv = (rings - 1) * segs + 2;
+    size_t nf = 2 * segs * (rings - 1);
+    size_t r, s, f = 0;
+    fastf_t *verts = (fastf_t *)bu_malloc(nv * 3 * sizeof(fastf_t), "bench bot verts");
+    int *faces = (int *)bu_malloc(nf * 3 * sizeof(int), "bench bot faces");
+    int top = (int)nv - 2, bot = (int)nv - 1;
+    fastf_t radius = BENCH_CELL * bp->side / 2.0;
+
+    for (r = 1; r < rings; r++) {
+	fastf_t phi = M_PI * r / rings;
+	for (s = 0; s < segs; s++) {
+	    fastf_t th = M_2PI * s / segs;
+	    VSET(&verts[((r - 1) * segs + s) * 3], radius * sin(phi) * cos(th), radius * sin(phi) * sin(th), radius * cos(phi));
+	}
+    }
+    VSET(&verts[top * 3], 0, 0, radius);
+    VSET(&verts[bot * 3], 0, 0, -radius);
+
+    for (s = 0; s < segs; s++) {
+	int s1 = (int)((s + 1) % segs);
+	faces[f++] = top; faces[f++] = (int)s; faces[f++] = s1;
+	for (r = 1; r + 1 < rings; r++) {
+	    int a = (int)((r - 1) * segs), b = (int)(r * segs);
+	    faces[f++] = a + (int)s; faces[f++] = b + (int)s; faces[f++] = b + s1;
+	    faces[f++] = a + (int)s; faces[f++] = b + s1; faces[f++] = a + s1;
+	}
+	faces[f++] = bot; faces[f++] = (int)((rings - 2) * segs) + s1; faces[f++] = (int)((rings - 2) * segs + s);
+    }
+
+    mk_bot(bp->fp, "huge.bot", RT_BOT_SOLID, RT_BOT_CCW, 0, nv, f / 3, verts, faces, NULL, NULL);
+    bench_region(bp, "huge.r", "huge.bot", 0);
+
+    bu_free(verts, "bench bot verts");
+    bu_free(faces, "bench bot faces");
+}
+
+
+/**
+ * @brief Group names[0..n) into combinations, fan at a time, until
+ * depth levels have been built and one combination remains.  The
+ * names array is reused for each level.
+ */
+static void
+bench_tree(const struct bench *bp, char **names, size_t n)
+{
+    size_t fan = 2;
+    int level;
+
+    if (bp->depth > 0)
+	fan = (size_t)ceil(pow((double)n, 1.0 / bp->depth));
+    if (fan < 2)
+	fan = 2;
+
+    for (level = 1; level <= bp->depth || n > 1; level++) {
+	size_t i, groups = (n + fan - 1) / fan;
+
+	for (i = 0; i < groups; i++) {
+	    struct wmember head;
+	    struct bu_vls name = BU_VLS_INIT_ZERO;
+	    size_t j;
+
+	    BU_LIST_INIT(&head.l);
+	    for (j = i * fan; j < n && j < (i + 1) * fan; j++) {
+		(void)mk_addmember(names[j], &head.l, NULL, WMOP_UNION);
+		bu_free(names[j], "bench name");
+	    }
+	    bu_vls_printf(&name, "g%d.%lu", level, (unsigned long)i);
+	    mk_lcomb(bp->fp, bu_vls_addr(&name), &head, 0, NULL, NULL, NULL, 0);
+	    names[i] = bu_vls_strdup(&name);
+	    bu_vls_free(&name);
+	}
+	n = groups;
+    }
+
+    if (n == 1) {
+	struct wmember head;
+	BU_LIST_INIT(&head.l);
+	(void)mk_addmember(names[0], &head.l, NULL, WMOP_UNION);
+	mk_lcomb(bp->fp, "regions.c", &head, 0, NULL, NULL, NULL, 0);
+	bu_free(names[0], "bench name");
+    }
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    static const char usage[] = "Usage: %s [-n regions] [-d depth] [-b bot_faces] [-i instances] [-S submodels] [-m] out.g\n";
+
+    struct bench bench = {NULL, NULL, 1000, 4, 0, 0, 0, 0, 1};
+    struct wmember top;
+    char **names;
+    char file[256];
+    size_t k, n;
+    int c;
+
+    bu_setprogname(argv[0]);
+
+    while ((c = bu_getopt(argc, argv, "n:d:b:i:S:m")) != -1) {
+	switch (c) {
+	    case 'n':
+		bench.nregions = (size_t)atol(bu_optarg);
+		break;
+	    case 'd':
+		bench.depth = atoi(bu_optarg);
+		break;
+	    case 'b':
+		bench.botfaces = (size_t)atol(bu_optarg);
+		break;
+	    case 'i':
+		bench.instances = (size_t)atol(bu_optarg);
+		break;
+	    case 'S':
+		bench.submodels = (size_t)atol(bu_optarg);
+		break;
+	    case 'm':
+		bench.mix = 1;
+		break;
+	    default:
+		bu_exit(1, usage, argv[0]);
+	}
+    }
+    if (bu_optind + 1 != argc)
+	bu_exit(1, usage, argv[0]);
+    bench.dbname = argv[bu_optind];
+
+    if ((bench.fp = wdb_fopen(bench.dbname)) == RT_WDB_NULL)
+	bu_exit(1, "pov-bench: unable to create %s\n", bench.dbname);
+    mk_id(bench.fp, "g-pov benchmark");
+
+    n = bench.nregions + bench.instances;
+    while (bench.side * bench.side * bench.side < n)
+	bench.side++;
+
+    BU_LIST_INIT(&top.l);
+
+    /* N regions on a grid, under a tree of the requested depth */
+    if (bench.mix) {
+	snprintf(file, sizeof(file), "%s.ebm", bench.dbname);
+	bench_datafile(file, 16 * 16, bench_ebm_cell);
+	snprintf(file, sizeof(file), "%s.vol", bench.dbname);
+	bench_datafile(file, 12 * 12 * 12, bench_vol_cell);
+	snprintf(file, sizeof(file), "%s.dsp", bench.dbname);
+	bench_datafile(file, 32 * 32 * 2, bench_dsp_cell);
+	bench_sketch(bench.fp, "square.sketch", 4);
+	bench_sketch(bench.fp, "triangle.sketch", 3);
+    }
+    names = (char **)bu_calloc(bench.nregions + 1, sizeof(char *), "bench names");
+    for (k = 0; k < bench.nregions; k++) {
+	struct bu_vls sname = BU_VLS_INIT_ZERO;
+	struct bu_vls rname = BU_VLS_INIT_ZERO;
+	point_t p;
+	int ret;
+
+	bench_cell(&bench, k, p);
+	bu_vls_printf(&sname, "s%lu", (unsigned long)k);
+	bu_vls_printf(&rname, "r%lu", (unsigned long)k);
+	if (!bench.mix)
+	    ret = mk_sph(bench.fp, bu_vls_addr(&sname), p, 3.0);
+	else if (k % 26 < 24)
+	    ret = bench_solid(&bench, bu_vls_addr(&sname), k % 26, p);
+	else
+	    ret = bench_sketch_solid(&bench, bu_vls_addr(&sname), k % 26, p);
+	if (ret < 0)
+	    bu_log("pov-bench: unable to make %s\n", bu_vls_addr(&sname));
+	bench_region(&bench, bu_vls_addr(&rname), bu_vls_addr(&sname), k);
+	names[k] = bu_vls_strdup(&rname);
+
+	bu_vls_free(&sname);
+	bu_vls_free(&rname);
+    }
+    if (bench.nregions > 0) {
+	bench_tree(&bench, names, bench.nregions);
+	(void)mk_addmember("regions.c", &top.l, NULL, WMOP_UNION);
+    }
+    bu_free(names, "bench names");
+
+    if (bench.botfaces > 0) {
+	bench_bot(&bench);
+	(void)mk_addmember("huge.r", &top.l, NULL, WMOP_UNION);
+    }
+
+    /* an eight region assembly, placed by matrix and by submodel */
+    if (bench.instances > 0 || bench.submodels > 0) {
+	struct wmember assy;
+	struct wmember placed;
+
+	BU_LIST_INIT(&assy.l);
+	for (k = 0; k < 8; k++) {
+	    struct bu_vls sname = BU_VLS_INIT_ZERO;
+	    struct bu_vls rname = BU_VLS_INIT_ZERO;
+	    point_t p;
+
+	    VSET(p, (k & 1) * 4.0, ((k >> 1) & 1) * 4.0, ((k >> 2) & 1) * 4.0);
+	    bu_vls_printf(&sname, "assembly.s%lu", (unsigned long)k);
+	    bu_vls_printf(&rname, "assembly.r%lu", (unsigned long)k);
+	    mk_sph(bench.fp, bu_vls_addr(&sname), p, 1.5);
+	    bench_region(&bench, bu_vls_addr(&rname), bu_vls_addr(&sname), k);
+	    (void)mk_addmember(bu_vls_addr(&rname), &assy.l, NULL, WMOP_UNION);
+	    bu_vls_free(&sname);
+	    bu_vls_free(&rname);
+	}
+	mk_lcomb(bench.fp, BENCH_ASSEMBLY, &assy, 0, NULL, NULL, NULL, 0);
+
+	BU_LIST_INIT(&placed.l);
+	for (k = 0; k < bench.instances; k++) {
+	    mat_t m;
+	    point_t p;
+
+	    bench_cell(&bench, bench.nregions + k, p);
+	    MAT_IDN(m);
+	    MAT_DELTAS_VEC(m, p);
+	    (void)mk_addmember(BENCH_ASSEMBLY, &placed.l, m, WMOP_UNION);
+	}
+	for (k = 0; k < bench.submodels; k++) {
+	    struct bu_vls sname = BU_VLS_INIT_ZERO;
+	    struct wmember head;
+	    mat_t m;
+	    point_t p;
+
+	    /* submodels stand in a row beside the grid */
+	    bu_vls_printf(&sname, "sub%lu", (unsigned long)k);
+	    mk_submodel(bench.fp, bu_vls_addr(&sname), "", BENCH_ASSEMBLY, 0);
+	    BU_LIST_INIT(&head.l);
+	    VSET(p, -2.0 * BENCH_CELL, k * BENCH_CELL, 0);
+	    MAT_IDN(m);
+	    MAT_DELTAS_VEC(m, p);
+	    (void)mk_addmember(bu_vls_addr(&sname), &head.l, m, WMOP_UNION);
+	    bu_vls_strcat(&sname, ".r");
+	    mk_lcomb(bench.fp, bu_vls_addr(&sname), &head, 1, NULL, NULL, palette[k % 8], 0);
+	    (void)mk_addmember(bu_vls_addr(&sname), &placed.l, NULL, WMOP_UNION);
+	    bu_vls_free(&sname);
+	}
+	mk_lcomb(bench.fp, "placed.c", &placed, 0, NULL, NULL, NULL, 0);
+	(void)mk_addmember("placed.c", &top.l, NULL, WMOP_UNION);
+    }
+
+    mk_lcomb(bench.fp, "all", &top, 0, NULL, NULL, NULL, 0);
+    wdb_close(bench.fp);
+
+    return 0;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * c-file-style: "stroustrup"
+ * End:
+ * ex: shiftwidth=4 tabstop=8
+ */
@@ -0,0 +1,174 @@
+#!/bin/sh
+#                    P O V - B E N C H . S H
+# BRL-CAD
+#
+# Copyright (c) 2014 United States Government as represented by
+# the U.S. Army Research Laboratory.
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public License
+# version 2.1 as published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this file; see the file named COPYING for more
+# information.
+#
+###
+#
+# Scaling benchmark for g-pov.
+#
+# Generates a suite of databases with pov-bench, converts each with
+# g-pov for every output mode, and reports regions/s, MB/s of scene
+# written and peak RSS against a stored baseline.  Only the cases with
+# primitives that g-pov converts in parallel (the EBM and VOL solids of
+# the mix) are run for every CPU count; the rest are run with one.
+#
+# Usage: pov-bench.sh [-b baseline] [-s] [-P "1 2 4"] [-w workdir] [-q]
+#
+#   -b FILE  baseline to compare with (default pov-bench.baseline)
+#   -s       save this run as the baseline
+#   -P LIST  CPU counts to run the parallel cases with (default "1 2 4 8")
+#   -w DIR   where the databases and scenes go (default a temporary
+#            directory, removed afterwards)
+#   -q       quick: a tenth of the default sizes
+#
+# G_POV and POV_BENCH name the programs when they are not on PATH.
+# Peak RSS needs GNU time as /usr/bin/time.
+#
+###
+
+G_POV="${G_POV:-g-pov}"
+POV_BENCH="${POV_BENCH:-pov-bench}"
+BASELINE=pov-bench.baseline
+SAVE=0
+CPUS="1 2 4 8"
+WORKDIR=""
+SCALE=1
+
+while getopts "b:sP:w:q" opt ; do
+    case $opt in
+	b) BASELINE="$OPTARG" ;;
+	s) SAVE=1 ;;
+	P) CPUS="$OPTARG" ;;
+	w) WORKDIR="$OPTARG" ;;
+	q) SCALE=10 ;;
+	*) echo "Usage: $0 [-b baseline] [-s] [-P \"1 2 4\"] [-w workdir] [-q]" 1>&2 ; exit 1 ;;
+    esac
+done
+
+CLEANUP=0
+if test "x$WORKDIR" = "x" ; then
+    WORKDIR=`mktemp -d "${TMPDIR:-/tmp}/pov-bench.XXXXXX"` || exit 1
+    CLEANUP=1
+fi
+mkdir -p "$WORKDIR" || exit 1
+
+# stop the run, leaving no partial results or baseline behind
+fail() {
+    echo "$@" 1>&2
+    if test "x$CLEANUP" = "x1" ; then
+	rm -rf "$WORKDIR"
+    fi
+    exit 1
+}
+
+# nanoseconds since the epoch, to the second where date has no %N
+now_ns() {
+    ns=`date +%s%N 2>/dev/null`
+    case "$ns" in
+	*[!0-9]*|"") echo "`date +%s`000000000" ;;
+	*) echo "$ns" ;;
+    esac
+}
+
+TIME=""
+if test -x /usr/bin/time && /usr/bin/time -f "%M" true >/dev/null 2>&1 ; then
+    TIME=/usr/bin/time
+fi
+
+# case name, whether -P applies to it, and pov-bench arguments
+SUITE="regions:serial:-n $((100000 / SCALE)) -d 3
+deep:serial:-n $((20000 / SCALE)) -d 24
+bot:serial:-n 1 -b $((4000000 / SCALE))
+instances:serial:-n 64 -i $((2000 / SCALE)) -S $((2000 / SCALE))
+mix:parallel:-n $((26000 / SCALE)) -m"
+
+RESULTS="$WORKDIR/results"
+: > "$RESULTS"
+
+# read from a here-document, not a pipe, so that fail() ends the script
+while IFS=: read name kind args ; do
+    db="$WORKDIR/$name.g"
+    echo "generating $name ($args)" 1>&2
+    $POV_BENCH $args "$db" || fail "pov-bench failed for $name"
+
+    cpus=1
+    if test "x$kind" = "xparallel" ; then
+	cpus="$CPUS"
+    fi
+    for ncpu in $cpus ; do
+	for mode in file pipe ; do
+	    stats="$WORKDIR/$name.$ncpu.$mode.json"
+	    timing="$WORKDIR/$name.$ncpu.$mode.time"
+	    if test "x$mode" = "xfile" ; then
+		set -- $G_POV -P $ncpu --stats-json "$stats" -o "$WORKDIR/$name.pov" "$db" all
+	    else
+		set -- $G_POV -P $ncpu --stats-json "$stats" "$db" all
+	    fi
+
+	    # GNU time gives elapsed seconds and peak RSS, otherwise only the time;
+	    # the statistics are only written by a run that succeeds
+	    rm -f "$stats"
+	    if test "x$TIME" != "x" ; then
+		$TIME -f "%e %M" -o "$timing" "$@" 2>/dev/null | cat > /dev/null
+	    else
+		start=`now_ns`
+		"$@" 2>/dev/null | cat > /dev/null
+		echo "$start `now_ns`" | awk '{ printf "%.3f -\n", ($2 - $1) / 1e9 }' > "$timing"
+	    fi
+	    test -s "$stats" || fail "g-pov failed for $name with $ncpu cpus, $mode output"
+
+	    regions=`sed -n 's/.*"type": "region", "count": \([0-9]*\).*/\1/p' "$stats"`
+	    bytes=`sed -n 's/^ *"bytes": \([0-9]*\),$/\1/p' "$stats"`
+	    echo "$name $mode $ncpu ${regions:-0} ${bytes:-0} `tail -n 1 "$timing"`" | \
+		awk '{ t = ($6 > 0) ? $6 : 0.01 ;
+		       printf "%s %s %s %.1f %.2f %s\n", $1, $2, $3, $4 / t, $5 / t / 1048576, $7 }' >> "$RESULTS"
+	done
+    done
+done <<EOF
+$SUITE
+EOF
+
+if test -f "$BASELINE" ; then
+    awk 'function pct(now, then) { return (then > 0) ? sprintf("%+.1f%%", 100 * (now - then) / then) : "-" }
+	 NR == FNR { key = $1 " " $2 " " $3 ; reg[key] = $4 ; mb[key] = $5 ; rss[key] = $6 ; next }
+	 BEGIN { printf "%-10s %-5s %4s %12s %8s %10s %8s %10s %8s\n", "case", "mode", "cpus", "regions/s", "", "MB/s", "", "RSS kB", "" }
+	 { key = $1 " " $2 " " $3
+	   printf "%-10s %-5s %4s %12s %8s %10s %8s %10s %8s\n", $1, $2, $3, $4, pct($4, reg[key]), $5, pct($5, mb[key]), $6, pct($6, rss[key]) }' \
+	"$BASELINE" "$RESULTS"
+else
+    awk 'BEGIN { printf "%-10s %-5s %4s %12s %10s %10s\n", "case", "mode", "cpus", "regions/s", "MB/s", "RSS kB" }
+	 { printf "%-10s %-5s %4s %12s %10s %10s\n", $1, $2, $3, $4, $5, $6 }' "$RESULTS"
+fi
+
+if test "x$SAVE" = "x1" ; then
+    cp "$RESULTS" "$BASELINE" && echo "baseline saved to $BASELINE" 1>&2
+fi
+
+if test "x$CLEANUP" = "x1" ; then
+    rm -rf "$WORKDIR"
+fi
+
+# Local Variables:
+# tab-width: 8
+# mode: sh
+# sh-indentation: 4
+# sh-basic-offset: 4
+# indent-tabs-mode: t
+# End:
+# ex: shiftwidth=4 tabstop=8
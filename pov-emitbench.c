@@ -0,0 +1,339 @@
+/*                  P O V - E M I T B E N C H . C
+ * BRL-CAD
+ *
+ * Copyright (c) 1993-2014 United States Government as represented by
+ * the U.S. Army Research Laboratory.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this file; see the file named COPYING for more
+ * information.
+ *
+ */
+/** @file conv/pov-emitbench.c
+ * @brief Time the g-pov emitters on fixed primitives.
+ *
+ * Calls primitive_func() from g-pov.c directly on canned tori, cones,
+ * ellipsoids, ARBs, halfspaces and BOTs of several sizes, with no
+ * database or tree walk, and reports the time and scene bytes each
+ * emitter spends per primitive.  Each fixture is warmed up and then
+ * timed over a number of repetitions, and the minimum, median, mean
+ * and standard deviation of the repetitions are reported.
+ *
+ * The scene goes to /dev/null unless -o names a file, so stdio
+ * formatting and buffering are part of what is timed but the disk is
+ * not.
+ *
+ */
+
+/* g-pov.c provides the emitters; its main() is left out */
+#define POV_EMITTERS_ONLY
+#include "g-pov.c"
+
+
+struct fixture {
+    const char *name;
+    int type;
+    void *ptr;
+};
+
+static struct rt_tor_internal fix_tor;
+static struct rt_tgc_internal fix_rcc, fix_trc, fix_tgc;
+static struct rt_ell_internal fix_ell, fix_sph;
+static struct rt_arb_internal fix_arb;
+static struct rt_half_internal fix_half;
+static struct rt_bot_internal fix_bot[3];
+
+/* quads on a side of each BOT fixture, two triangles each */
+static const size_t bot_sides[3] = {2, 16, 128};
+
+
+/**
+ * @brief A flat n by n grid of quads split into triangles.
+ */
+static void
+fixture_bot(struct rt_bot_internal *bot, size_t n)
+{
+    size_t i, j, f = 0;
+
+    memset(bot, 0, sizeof(*bot));
+    bot->magic = RT_BOT_INTERNAL_MAGIC;
+    bot->mode = RT_BOT_SURFACE;
+    bot->orientation = RT_BOT_CCW;
+    bot->num_vertices = (n + 1) * (n + 1);
+    bot->num_faces = 2 * n * n;
+    bot->vertices = (fastf_t *)bu_malloc(bot->num_vertices * 3 * sizeof(fastf_t), "fixture bot verts");
+    bot->faces = (int *)bu_malloc(bot->num_faces * 3 * sizeof(int), "fixture bot faces");
+
+    for (i = 0; i <= n; i++)
+	for (j = 0; j <= n; j++)
+	    VSET(&bot->vertices[(i * (n + 1) + j) * 3], j * 10.0, i * 10.0, (i + j) * 0.5);
+
+    for (i = 0; i < n; i++) {
+	for (j = 0; j < n; j++) {
+	    int a = (int)(i * (n + 1) + j), b = a + (int)(n + 1);
+	    bot->faces[f++] = a; bot->faces[f++] = a + 1; bot->faces[f++] = b + 1;
+	    bot->faces[f++] = a; bot->faces[f++] = b + 1; bot->faces[f++] = b;
+	}
+    }
+}
+
+
+/**
+ * @brief Fill in the fixtures.  The three TGCs take the cylinder,
+ * cone and general cone branches of the TGC emitter.
+ */
+static size_t
+fixture_init(struct fixture *fix)
+{
+    size_t n = 0, k;
+
+    fix_tor.magic = RT_TOR_INTERNAL_MAGIC;
+    VSET(fix_tor.v, 10, 20, 30);
+    VSET(fix_tor.h, 0, 0, 1);
+    VSET(fix_tor.a, 40, 0, 0);
+    VSET(fix_tor.b, 0, 40, 0);
+    fix_tor.r_a = fix_tor.r_b = 40;
+    fix_tor.r_h = 5;
+    fix[n].name = "tor"; fix[n].type = ID_TOR; fix[n++].ptr = &fix_tor;
+
+    fix_rcc.magic = RT_TGC_INTERNAL_MAGIC;
+    VSET(fix_rcc.v, 0, 0, 0);
+    VSET(fix_rcc.h, 0, 0, 100);
+    VSET(fix_rcc.a, 25, 0, 0);
+    VSET(fix_rcc.b, 0, 25, 0);
+    VMOVE(fix_rcc.c, fix_rcc.a);
+    VMOVE(fix_rcc.d, fix_rcc.b);
+    fix[n].name = "tgc-rcc"; fix[n].type = ID_TGC; fix[n++].ptr = &fix_rcc;
+
+    fix_trc = fix_rcc;
+    VSET(fix_trc.c, 10, 0, 0);
+    VSET(fix_trc.d, 0, 10, 0);
+    fix[n].name = "tgc-trc"; fix[n].type = ID_TGC; fix[n++].ptr = &fix_trc;
+
+    fix_tgc = fix_rcc;
+    VSET(fix_tgc.b, 0, 15, 0);
+    VSET(fix_tgc.c, 10, 0, 0);
+    VSET(fix_tgc.d, 0, 5, 0);
+    fix[n].name = "tgc"; fix[n].type = ID_TGC; fix[n++].ptr = &fix_tgc;
+
+    fix_ell.magic = RT_ELL_INTERNAL_MAGIC;
+    VSET(fix_ell.v, 5, 5, 5);
+    VSET(fix_ell.a, 30, 0, 0);
+    VSET(fix_ell.b, 0, 20, 0);
+    VSET(fix_ell.c, 0, 0, 10);
+    fix[n].name = "ell"; fix[n].type = ID_ELL; fix[n++].ptr = &fix_ell;
+
+    fix_sph = fix_ell;
+    VSET(fix_sph.b, 0, 30, 0);
+    VSET(fix_sph.c, 0, 0, 30);
+    fix[n].name = "sph"; fix[n].type = ID_SPH; fix[n++].ptr = &fix_sph;
+
+    fix_arb.magic = RT_ARB_INTERNAL_MAGIC;
+    for (k = 0; k < 8; k++)
+	VSET(fix_arb.pt[k], (k == 1 || k == 2 || k == 5 || k == 6) ? 50 : 0,
+	     (k == 2 || k == 3 || k == 6 || k == 7) ? 50 : 0, (k >= 4) ? 50 : 0);
+    fix[n].name = "arb8"; fix[n].type = ID_ARB8; fix[n++].ptr = &fix_arb;
+
+    fix_half.magic = RT_HALF_INTERNAL_MAGIC;
+    HSET(fix_half.eqn, 0, 0, 1, -10);
+    fix[n].name = "half"; fix[n].type = ID_HALF; fix[n++].ptr = &fix_half;
+
+    for (k = 0; k < 3; k++) {
+	static char names[3][32];
+	fixture_bot(&fix_bot[k], bot_sides[k]);
+	snprintf(names[k], sizeof(names[k]), "bot-%lu", (unsigned long)fix_bot[k].num_faces);
+	fix[n].name = names[k]; fix[n].type = ID_BOT; fix[n++].ptr = &fix_bot[k];
+    }
+
+    return n;
+}
+
+
+static int
+time_cmp(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+
+/**
+ * @brief Call primitive_func() on one fixture for at least min_us,
+ * returning the number of calls made.
+ */
+static size_t
+fixture_run(struct fixture *fp, struct db_tree_state *tsp, struct db_full_path *pathp, struct user_data *ud, int64_t min_us, int64_t *elapsed)
+{
+    struct rt_db_internal intern;
+    int64_t start = bu_gettime(), now;
+    size_t calls = 0, batch = 1;
+
+    RT_DB_INTERNAL_INIT(&intern);
+    intern.idb_major_type = DB5_MAJORTYPE_BRLCAD;
+    intern.idb_type = fp->type;
+    intern.idb_meth = &OBJ[fp->type];
+    intern.idb_ptr = fp->ptr;
+
+    /* check the clock only between growing batches of calls */
+    do {
+	size_t i;
+	for (i = 0; i < batch; i++)
+	    (void)primitive_func(tsp, pathp, &intern, ud);
+	calls += batch;
+	if (batch < 1024)
+	    batch *= 2;
+	now = bu_gettime();
+    } while (now - start < min_us);
+
+    *elapsed = now - start;
+    return calls;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    static const char usage[] = "Usage: %s [-r repetitions] [-w warmups] [-t ms_per_repetition] [-f fixture] [-o scene_file] [-v]\n";
+
+    struct user_data ud = {0, BN_TOL_INIT_ZERO, RT_TESS_TOL_INIT_ZERO, 1, 0};
+    struct fixture fix[16];
+    struct db_tree_state state;
+    const char *only = NULL;
+    const char *scene = "/dev/null";
+    int reps = 20, warmups = 3;
+    int64_t min_us = 10000;
+    double *ns;
+    size_t nfix, f;
+    int c, r;
+
+    bu_setprogname(argv[0]);
+
+    while ((c = bu_getopt(argc, argv, "r:w:t:f:o:v")) != -1) {
+	switch (c) {
+	    case 'r':
+		reps = atoi(bu_optarg);
+		break;
+	    case 'w':
+		warmups = atoi(bu_optarg);
+		break;
+	    case 't':
+		min_us = (int64_t)(atof(bu_optarg) * 1000.0);
+		break;
+	    case 'f':
+		only = bu_optarg;
+		break;
+	    case 'o':
+		scene = bu_optarg;
+		break;
+	    case 'v':		/* primitive_func()'s per call messages, timed too */
+		pov_log_level = POV_LOG_INFO;
+		break;
+	    default:
+		bu_exit(1, usage, argv[0]);
+	}
+    }
+    if (reps < 1 || warmups < 0 || min_us < 1 || bu_optind != argc)
+	bu_exit(1, usage, argv[0]);
+
+    if (freopen(scene, "w", stdout) == NULL) {
+	perror(scene);
+	bu_exit(1, "pov-emitbench: unable to open %s for writing\n", scene);
+    }
+
+    /* the same tolerances g-pov starts with */
+    ud.tol.magic = BN_TOL_MAGIC;
+    ud.tol.dist = 0.0005;
+    ud.tol.dist_sq = ud.tol.dist * ud.tol.dist;
+    ud.tol.perp = 1e-6;
+    ud.tol.para = 1 - ud.tol.perp;
+    ud.ttol.magic = RT_TESS_TOL_MAGIC;
+    ud.ttol.rel = 0.01;
+
+    state = rt_initial_tree_state;
+    state.ts_tol = &ud.tol;
+    state.ts_ttol = &ud.ttol;
+    state.ts_resp = &rt_uniresource;
+    VSET(state.ts_mater.ma_color, 0.8, 0.2, 0.2);
+    state.ts_mater.ma_color_valid = 1;
+    state.ts_mater.ma_shader = "plastic";
+
+    nfix = fixture_init(fix);
+    ns = (double *)bu_malloc(reps * sizeof(double), "repetition times");
+
+    bu_log("%-10s %10s %12s %12s %12s %10s %12s\n", "fixture", "calls", "min ns", "median ns", "mean ns", "stddev", "bytes");
+    for (f = 0; f < nfix; f++) {
+	struct directory dir;
+	struct db_full_path path;
+	size_t calls = 0, bytes;
+	double mean = 0.0, var = 0.0;
+	int64_t elapsed;
+
+	if (only && bu_strncmp(fix[f].name, only, strlen(only)))
+	    continue;
+
+	memset(&dir, 0, sizeof(dir));
+	dir.d_magic = RT_DIR_MAGIC;
+	dir.d_namep = (char *)fix[f].name;
+	dir.d_flags = RT_DIR_SOLID;
+	db_full_path_init(&path);
+	db_add_node_to_full_path(&path, &dir);
+
+	/* first-use declarations (macros, materials) go out here */
+	for (r = 0; r < warmups; r++)
+	    (void)fixture_run(&fix[f], &state, &path, &ud, min_us, &elapsed);
+
+	bytes = pov_bytes;
+	for (r = 0; r < reps; r++) {
+	    size_t n = fixture_run(&fix[f], &state, &path, &ud, min_us, &elapsed);
+	    ns[r] = elapsed * 1000.0 / n;
+	    calls += n;
+	    mean += ns[r];
+	}
+	bytes = pov_bytes - bytes;
+
+	db_free_full_path(&path);
+	pov_log_flush();
+
+	mean /= reps;
+	for (r = 0; r < reps; r++)
+	    var += (ns[r] - mean) * (ns[r] - mean);
+	if (reps > 1)
+	    var /= reps - 1;
+	qsort(ns, reps, sizeof(double), time_cmp);
+
+	bu_log("%-10s %10lu %12.1f %12.1f %12.1f %10.1f %12.1f\n", fix[f].name, (unsigned long)calls,
+	       ns[0], (reps % 2) ? ns[reps / 2] : (ns[reps / 2 - 1] + ns[reps / 2]) / 2.0,
+	       mean, sqrt(var), (double)bytes / calls);
+    }
+
+    fflush(stdout);
+    for (f = 0; f < 3; f++) {
+	bu_free(fix_bot[f].vertices, "fixture bot verts");
+	bu_free(fix_bot[f].faces, "fixture bot faces");
+    }
+    bu_free(ns, "repetition times");
+    pov_material_free();
+    pov_log_free();
+
+    return 0;
+}
+
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * c-file-style: "stroustrup"
+ * End:
+ * ex: shiftwidth=4 tabstop=8
+ */